@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include <string.h>
+
+#include "hui.h"
+
+HuiDecoder::HuiDecoder(MidiDecoder::msg_cb cb, void* arg) :
+	emit(cb),
+	emit_arg(arg),
+	zone(0)
+{
+	memset(fader_msb, 0, sizeof(fader_msb));
+}
+
+void HuiDecoder::message (const unsigned char* msg, size_t len, uint64_t stamp, void* arg)
+{
+	((HuiDecoder*) arg)->decode(msg, len, stamp);
+}
+
+// HUI zone/port to the mcp lamp note for the same thing, -1 if we
+// have nowhere to show it
+static int hui_lamp_note (int zone, int port)
+{
+	if (zone < 8) {
+		// channel strips
+		switch (port) {
+		case 1:	// select
+			return 24 + zone;
+		case 2:	// mute
+			return 16 + zone;
+		case 3:	// solo
+			return 8 + zone;
+		case 7:	// record ready
+			return zone;
+		default:
+			return -1;
+		}
+	}
+	switch (zone) {
+	case 0x0e:	// transport
+		switch (port) {
+		case 1: return 0x5b;	// rewind
+		case 2: return 0x5c;	// fast forward
+		case 3: return 0x5d;	// stop
+		case 4: return 0x5e;	// play
+		case 5: return 0x5f;	// record
+		default: return -1;
+		}
+	case 0x0f:	// more transport
+		return (port == 3) ? 0x56 : -1;	// loop -> cycle
+	case 0x18:	// automation mode
+		switch (port) {
+		case 0: return 0x4c;	// trim
+		case 1: return 0x4e;	// latch
+		case 2: return 0x4a;	// read
+		case 4: return 0x4b;	// write
+		case 5: return 0x4d;	// touch
+		default: return -1;
+		}
+	default:
+		return -1;
+	}
+}
+
+void HuiDecoder::lamp (int port, bool on, uint64_t stamp)
+{
+	int note = hui_lamp_note(zone, port);
+	if (note >= 0) {
+		unsigned char m[3] = { 0x90, (unsigned char) note, (unsigned char) (on ? 0x7f : 0x00) };
+		emit(m, 3, stamp, emit_arg);
+	}
+}
+
+// HUI strip names are 4 chars, ours are 7
+void HuiDecoder::strip_text (int ch, const unsigned char* text, uint64_t stamp)
+{
+	if (ch < 8) {
+		unsigned char m[15] = { 0xf0, 0x00, 0x00, 0x66, 0x14, 0x12, (unsigned char) (ch * 7) };
+		memcpy(&m[7], text, 4);
+		memset(&m[11], ' ', 3);
+		m[14] = 0xf7;
+		emit(m, 15, stamp, emit_arg);
+	} else if (ch == 8) {
+		// select assign display, we only have two chars
+		unsigned char m[3] = { 0xb0, 0x4b, text[0] };
+		emit(m, 3, stamp, emit_arg);
+		m[1] = 0x4a;
+		m[2] = text[1];
+		emit(m, 3, stamp, emit_arg);
+	}
+}
+
+// The main display is 2 lines of 40 in zones of 10. The lower line
+// (zones 4 - 7) holds values lined up over the strips 5 chars each,
+// so that goes in our bottom line. The top line has no home.
+void HuiDecoder::main_text (int z, const unsigned char* text, uint64_t stamp)
+{
+	if (z < 4 || z > 7) {
+		return;
+	}
+	// each zone is two strips worth
+	for (int half = 0; half < 2; half++) {
+		int strip = (z - 4) * 2 + half;
+		unsigned char m[13] = { 0xf0, 0x00, 0x00, 0x66, 0x14, 0x12, (unsigned char) (56 + strip * 7) };
+		memcpy(&m[7], &text[half * 5], 5);
+		m[12] = 0xf7;
+		emit(m, 13, stamp, emit_arg);
+	}
+}
+
+// digits come least significant first, bit 4 is a decimal point
+void HuiDecoder::timecode (const unsigned char* digits, size_t n, uint64_t stamp)
+{
+	for (size_t i = 0; i < n && i < 10; i++) {
+		unsigned char m[3] = { 0xb0, (unsigned char) (0x40 + i), (unsigned char) ('0' + (digits[i] & 0x0f)) };
+		emit(m, 3, stamp, emit_arg);
+	}
+}
+
+void HuiDecoder::decode (const unsigned char* msg, size_t len, uint64_t stamp)
+{
+	switch (msg[0]) {
+	case 0xb0:
+		if (len < 3) {
+			break;
+		}
+		if (msg[1] == 0x0c) {
+			zone = msg[2];
+		} else if (msg[1] == 0x2c) {
+			lamp(msg[2] & 0x07, msg[2] & 0x40, stamp);
+		} else if (msg[1] < 0x08) {
+			fader_msb[msg[1]] = msg[2];
+		} else if (msg[1] >= 0x20 && msg[1] < 0x28) {
+			int ch = msg[1] - 0x20;
+			unsigned char m[3] = { (unsigned char) (0xe0 + ch), msg[2], fader_msb[ch] };
+			emit(m, 3, stamp, emit_arg);
+		} else if (msg[1] >= 0x10 && msg[1] < 0x18) {
+			// ring values are coded the same as mcp
+			unsigned char m[3] = { 0xb0, (unsigned char) (0x30 + msg[1] - 0x10), msg[2] };
+			emit(m, 3, stamp, emit_arg);
+		}
+		break;
+	case 0xa0:
+		// meters: channel, then side in the high nibble and level
+		// 0 - 12 in the low. We show the left side.
+		if (len >= 3 && msg[1] < 8 && !(msg[2] & 0x10)) {
+			unsigned char m[2] = { 0xd0, (unsigned char) ((msg[1] << 4) | (msg[2] & 0x0f)) };
+			emit(m, 2, stamp, emit_arg);
+		}
+		break;
+	case 0xf0:
+		if (len < 8 || msg[1] != 0x00 || msg[2] != 0x00 || msg[3] != 0x66
+				|| msg[4] != 0x05 || msg[5] != 0x00) {
+			break;
+		}
+		if (msg[6] == 0x10 && len >= 13) {
+			strip_text(msg[7], &msg[8], stamp);
+		} else if (msg[6] == 0x11) {
+			timecode(&msg[7], len - 8, stamp);
+		} else if (msg[6] == 0x12) {
+			// one or more zone number + 10 chars
+			for (size_t i = 7; i + 11 <= len - 1; i += 11) {
+				main_text(msg[i], &msg[i + 1], stamp);
+			}
+		}
+		break;
+	default:
+		// note on is only ever the ping, handled in process()
+		break;
+	}
+}
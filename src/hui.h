@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_HUI_H
+#define MCPDISP_HUI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mididecode.h"
+
+// HuiDecoder turns HUI messages from the daw into the mackie control
+// messages that mean the same thing and hands those on, so HUI ends
+// up in the same parser, surface and widgets as mcp does. Feed it
+// whole messages from a MidiDecoder.
+//
+// What is understood:
+//	zone/port lamps (cc 0x0c then 0x2c) for strips, transport,
+//	loop and automation mode
+//	4 char strip names, and the select/assign display (channel 8)
+//	the lower line of the main display, 5 chars per strip
+//	timecode, meters (poly pressure), faders and vpot rings
+// The ping (note on 0 0) is not answered here, that has to be done
+// in process() so it never waits on the gui. Pings are dropped.
+class HuiDecoder
+{
+public:
+	// emit gets mcp messages, arg is handed back to it
+	HuiDecoder(MidiDecoder::msg_cb emit, void* arg = 0);
+
+	// MidiDecoder callback, arg must be the HuiDecoder
+	static void message (const unsigned char* msg, size_t len, uint64_t stamp, void* arg);
+
+	void decode (const unsigned char* msg, size_t len, uint64_t stamp);
+
+private:
+	MidiDecoder::msg_cb emit;
+	void* emit_arg;
+	// zone picked by the last cc 0x0c
+	int zone;
+	// fader high 7 bits wait here for the low 7
+	unsigned char fader_msb[8];
+
+	void lamp (int port, bool on, uint64_t stamp);
+	void strip_text (int ch, const unsigned char* text, uint64_t stamp);
+	void main_text (int zone, const unsigned char* text, uint64_t stamp);
+	void timecode (const unsigned char* digits, size_t n, uint64_t stamp);
+};
+
+#endif
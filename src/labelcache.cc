@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include <stdio.h>
+
+#include <FL/Fl.H>
+#include <FL/fl_draw.H>
+
+#include "labelcache.h"
+
+LabelCache::LabelCache(size_t entries) :
+	hits(0),
+	misses(0),
+	max(entries)
+{
+	index.reserve(entries);
+}
+
+LabelCache::~LabelCache()
+{
+	clear();
+}
+
+void LabelCache::clear (void)
+{
+	for (std::list<Entry>::iterator i = lru.begin(); i != lru.end(); i++) {
+		fl_delete_offscreen(i->img);
+	}
+	lru.clear();
+	index.clear();
+}
+
+void LabelCache::render (Fl_Offscreen img, const char* text, Fl_Font font,
+	Fl_Fontsize size, Fl_Color fg, Fl_Color bg, Fl_Boxtype box, int w, int h)
+{
+	fl_begin_offscreen(img);
+	fl_draw_box(box, 0, 0, w, h, bg);
+	fl_font(font, size);
+	fl_color(fg);
+	// same spot Fl_Output puts its text
+	fl_draw(text, 3, (h - fl_height()) / 2 + fl_height() - fl_descent());
+	fl_end_offscreen();
+}
+
+void LabelCache::draw (const char* text, Fl_Font font, Fl_Fontsize size,
+	Fl_Color fg, Fl_Color bg, Fl_Boxtype box, int x, int y, int w, int h)
+{
+	char head[64];
+	snprintf(head, sizeof(head), "%d/%d/%u/%u/%d/%dx%d/", font, size, fg, bg, box, w, h);
+	std::string key(head);
+	key += text;
+
+	std::unordered_map<std::string, std::list<Entry>::iterator>::iterator found = index.find(key);
+	if (found != index.end()) {
+		// move to the front, list iterators stay good
+		lru.splice(lru.begin(), lru, found->second);
+		hits++;
+	} else {
+		misses++;
+		Fl_Offscreen img;
+		if (lru.size() >= max) {
+			// full, throw out the one unused the longest
+			Entry& old = lru.back();
+			index.erase(old.key);
+			fl_delete_offscreen(old.img);
+			lru.pop_back();
+		}
+		img = fl_create_offscreen(w, h);
+		render(img, text, font, size, fg, bg, box, w, h);
+		Entry e;
+		e.key = key;
+		e.img = img;
+		lru.push_front(e);
+		index[key] = lru.begin();
+	}
+	fl_copy_offscreen(x, y, w, h, lru.front().img, 0, 0);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_LABELCACHE_H
+#define MCPDISP_LABELCACHE_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <FL/Enumerations.H>
+#include <FL/x.H>
+
+// LabelCache keeps rendered copies of short pieces of text so that
+// text we have shown before is put back on screen with one copy
+// instead of laying out the font again. DAWs send the same few
+// hundred track names over and over as banks change so most strip
+// updates end up as a copy. Entries are keyed by everything that
+// changes how the text looks and the oldest is thrown out when full.
+class LabelCache
+{
+public:
+	LabelCache(size_t entries);
+	~LabelCache();
+
+	// draw text in a w x h box at x, y. Must be called from draw().
+	void draw (const char* text, Fl_Font font, Fl_Fontsize size,
+		Fl_Color fg, Fl_Color bg, Fl_Boxtype box,
+		int x, int y, int w, int h);
+	// forget everything, needed if the display goes away
+	void clear (void);
+
+	// for the curious
+	unsigned long hits;
+	unsigned long misses;
+
+private:
+	struct Entry {
+		std::string key;
+		Fl_Offscreen img;
+	};
+	size_t max;
+	// most recently used at the front
+	std::list<Entry> lru;
+	std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+	void render (Fl_Offscreen img, const char* text, Fl_Font font,
+		Fl_Fontsize size, Fl_Color fg, Fl_Color bg, Fl_Boxtype box,
+		int w, int h);
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include <string.h>
+
+#include "latency.h"
+
+Latency::Latency()
+{
+	memset(hist, 0, sizeof(hist));
+	memset(samples, 0, sizeof(samples));
+	memset(max_us, 0, sizeof(max_us));
+	memset(npend, 0, sizeof(npend));
+	waiting = 0;
+	missed = 0;
+}
+
+int Latency::classify (const unsigned char* msg, size_t len)
+{
+	switch (msg[0] & 0xf0) {
+	case 0xf0:
+		if (msg[0] == 0xf0 && len > 5 && msg[5] == 0x10) {
+			return LAT_TIME;
+		}
+		return (msg[0] == 0xf0) ? LAT_TEXT : LAT_OTHER;
+	case 0x90:
+		return LAT_LAMP;
+	case 0xd0:
+	case 0xa0:
+		return LAT_METER;
+	case 0xe0:
+		return LAT_FADER;
+	case 0xb0:
+		if (len > 1 && msg[1] >= 0x30 && msg[1] < 0x38) {
+			return LAT_VPOT;
+		}
+		return LAT_TIME;
+	default:
+		return LAT_OTHER;
+	}
+}
+
+const char* Latency::name (int cls)
+{
+	static const char* names[LAT_CLASSES + 1] = {
+		"text", "time", "lamp", "meter", "fader", "vpot", "other", "all"
+	};
+	return names[cls];
+}
+
+void Latency::event (int cls, uint64_t stamp)
+{
+	if (npend[cls] < LAT_PENDING) {
+		pend[cls][npend[cls]++] = stamp;
+		waiting++;
+	} else {
+		missed++;
+	}
+}
+
+void Latency::flushed (uint64_t now)
+{
+	for (int c = 0; c < LAT_CLASSES; c++) {
+		for (int i = 0; i < npend[c]; i++) {
+			// stamp may be a hair in the future if jack's clock
+			// guess for the event is off, call that zero
+			uint64_t us = (now > pend[c][i]) ? now - pend[c][i] : 0;
+			uint64_t b = us / LAT_BUCKET_US;
+			if (b >= LAT_BUCKETS) {
+				b = LAT_BUCKETS - 1;
+			}
+			hist[c][b]++;
+			samples[c]++;
+			if (us > max_us[c]) {
+				max_us[c] = us;
+			}
+		}
+		npend[c] = 0;
+	}
+	waiting = 0;
+}
+
+uint64_t Latency::count (int cls) const
+{
+	if (cls < LAT_CLASSES) {
+		return samples[cls];
+	}
+	uint64_t n = 0;
+	for (int c = 0; c < LAT_CLASSES; c++) {
+		n += samples[c];
+	}
+	return n;
+}
+
+uint64_t Latency::maximum (int cls) const
+{
+	if (cls < LAT_CLASSES) {
+		return max_us[cls];
+	}
+	uint64_t m = 0;
+	for (int c = 0; c < LAT_CLASSES; c++) {
+		if (max_us[c] > m) {
+			m = max_us[c];
+		}
+	}
+	return m;
+}
+
+uint64_t Latency::percentile (int cls, double pc) const
+{
+	uint64_t n = count(cls);
+	if (!n) {
+		return 0;
+	}
+	// the sample we want, counting from 1
+	uint64_t want = (uint64_t) (pc / 100.0 * (double) n + 0.5);
+	if (want < 1) {
+		want = 1;
+	}
+	uint64_t seen = 0;
+	for (int b = 0; b < LAT_BUCKETS; b++) {
+		if (cls < LAT_CLASSES) {
+			seen += hist[cls][b];
+		} else {
+			for (int c = 0; c < LAT_CLASSES; c++) {
+				seen += hist[c][b];
+			}
+		}
+		if (seen >= want) {
+			// report the top of the bucket, but never more than we saw
+			uint64_t us = (uint64_t) (b + 1) * LAT_BUCKET_US;
+			uint64_t m = maximum(cls);
+			return (us < m) ? us : m;
+		}
+	}
+	return maximum(cls);
+}
+
+void Latency::summary (char* buf, size_t len) const
+{
+	// overall numbers and whichever class is doing worst
+	int worst = LAT_CLASSES;
+	uint64_t worst_us = 0;
+	for (int c = 0; c < LAT_CLASSES; c++) {
+		uint64_t p = percentile(c, 99.0);
+		if (samples[c] && p >= worst_us) {
+			worst_us = p;
+			worst = c;
+		}
+	}
+	snprintf(buf, len, "latency ms  p50 %.1f  p99 %.1f  max %.1f  (worst p99: %s)",
+		percentile(LAT_CLASSES, 50.0) / 1000.0,
+		percentile(LAT_CLASSES, 99.0) / 1000.0,
+		maximum(LAT_CLASSES) / 1000.0,
+		name(worst));
+}
+
+void Latency::report (FILE* out) const
+{
+	fprintf(out, "event to pixel latency (ms)\n");
+	fprintf(out, "%-8s %10s %8s %8s %8s\n", "class", "count", "p50", "p99", "max");
+	for (int c = 0; c <= LAT_CLASSES; c++) {
+		if (!count(c)) {
+			continue;
+		}
+		fprintf(out, "%-8s %10llu %8.2f %8.2f %8.2f\n", name(c),
+			(unsigned long long) count(c),
+			percentile(c, 50.0) / 1000.0,
+			percentile(c, 99.0) / 1000.0,
+			maximum(c) / 1000.0);
+	}
+	if (missed) {
+		fprintf(out, "%llu events too many per frame to measure\n", (unsigned long long) missed);
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_LATENCY_H
+#define MCPDISP_LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// kinds of message we keep separate numbers for
+enum LatClass {
+	LAT_TEXT = 0,	// strip display sysex
+	LAT_TIME,	// timecode and assign chars
+	LAT_LAMP,	// note on lamps
+	LAT_METER,	// channel pressure meters
+	LAT_FADER,	// pitchbend fader feedback
+	LAT_VPOT,	// vpot ring cc
+	LAT_OTHER,
+	LAT_CLASSES
+};
+
+// histogram buckets are 100us wide, anything over 200ms goes in the last
+#define LAT_BUCKET_US	100
+#define LAT_BUCKETS	2001
+// most messages of one class we remember between two frames
+#define LAT_PENDING	4096
+
+// Latency measures how long it takes from a midi event arriving in
+// process() to the frame that shows it going out to the X server.
+// Times are jack_get_time() microseconds. event() is called as each
+// message is parsed and flushed() right after the frame is drawn.
+class Latency
+{
+public:
+	Latency();
+
+	// which class a parsed message counts as
+	static int classify (const unsigned char* msg, size_t len);
+	static const char* name (int cls);
+
+	// a message stamped at stamp has been parsed and waits for a frame
+	void event (int cls, uint64_t stamp);
+	// true if there are parsed messages not yet on screen
+	bool pending (void) const { return waiting > 0; }
+	// everything parsed so far is now on screen
+	void flushed (uint64_t now);
+
+	// percentile (0 - 100) in microseconds for one class,
+	// or all classes together if cls is LAT_CLASSES
+	uint64_t percentile (int cls, double pc) const;
+	uint64_t maximum (int cls) const;
+	uint64_t count (int cls) const;
+
+	// one line summary for the overlay
+	void summary (char* buf, size_t len) const;
+	// full table for --latency-report
+	void report (FILE* out) const;
+
+private:
+	uint32_t hist[LAT_CLASSES][LAT_BUCKETS];
+	uint64_t samples[LAT_CLASSES];
+	uint64_t max_us[LAT_CLASSES];
+	// events that have been parsed but not drawn yet
+	uint64_t pend[LAT_CLASSES][LAT_PENDING];
+	int npend[LAT_CLASSES];
+	int waiting;
+	// events we had no room to remember
+	uint64_t missed;
+};
+
+#endif
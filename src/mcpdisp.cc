@@ -22,6 +22,12 @@
 #include <signal.h>
 #include <iostream>
 #include <getopt.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
 
 //Jack includes
 #include <jack/jack.h>
@@ -36,57 +42,290 @@
 #include <FL/Fl_Pack.H>
 #include <FL/Fl_Progress.H>
 #include <FL/fl_ask.H>
+#include <FL/fl_draw.H>
+#include <FL/x.H>
+
+#include "mididecode.h"
+#include "surface.h"
+#include "latency.h"
+#include "trace.h"
+#include "labelcache.h"
+#include "snapshot.h"
+#include "osc.h"
+#include "hui.h"
+#include "meterhist.h"
+#include "rtlog.h"
+#include "rtcore.h"
 
 using namespace std;
 
-jack_client_t *client;
+jack_client_t *client = 0;
+// the name we ask jack for
+char jackname[16];
+// set by the jack setup thread once process() is running
+std::atomic<bool> jack_ready (false);
+// or why it never will be
+std::atomic<const char*> jack_error (0);
 
 // only need input to display things
 jack_port_t *input_port;
 // well, lets add a thru port to feed the surface
 jack_port_t *thru_port;
-// need ring buffer to go from real time to not
-jack_ringbuffer_t *midibuffer = 0;
+// need ring buffers to go from real time to not, one per lane
+// (see rtcore.h)
+jack_ringbuffer_t *midibuffer[LANES];
+// most records taken from a bulk lane per frame, so a burst is spread
+// over a few frames rather than making this one late
+#define LANE_BUDGET 256
+// optional port back to the daw so we can ask it for a full refresh
+jack_port_t *to_daw_port = 0;
+// set when the daw should be asked to send everything again
+std::atomic<bool> resync_request (false);
+// register the _to_daw port
+bool want_to_daw (false);
+
+// what process() has to say, printed from the gui thread
+RtLog rtlog;
 
 // state globals
+int protocol (PROTO_MCP);
 bool master (false);
 bool shotime (false);
-unsigned int siz (3);
+// pixels per unit of layout, 3 normally, 2 with -s, times --scale
+float siz (3.0);
 
-// text globals
-char line1_in[57];
-char line2_in[57];
-char disp2_in[3];
-char time1_in[14];
-char tm_bt;
-char midichunk[120];
+// a layout size in pixels at the current scale
+static inline int sz (float units)
+{
+	return (int) (units * siz + 0.5f);
+}
+
+// event to pixel latency, only measured if asked for
+bool measure (false);
+bool lat_report (false);
+Latency latency;
+
+// recent meter levels per strip, only kept with --meter-history
+bool meter_hist (false);
+MeterHistory meter_history;
+
+// rendered text and lamps. Strip text is mostly names we have seen,
+// and every lamp only has a couple of looks.
+LabelCache label_cache(512);
+
+// Lamp is a fixed glyph or word on a box where only the colors
+// change. Each look is rendered once into label_cache so turning a
+// lamp on or off is a copy, at any scale.
+class Lamp : public Fl_Widget
+{
+private:
+char text[16];
+Fl_Color fg;
+Fl_Font font;
+Fl_Fontsize size;
+public:
+	Lamp(int wx, int wy, int ww, int wh) :
+	Fl_Widget(wx, wy, ww, wh, "")
+	{
+		text[0] = 0x00;
+		fg = FL_BLACK;
+		font = 0;
+		size = sz(5);
+	}
+
+	void value (const char* t) {
+		strncpy(text, t, sizeof(text) - 1);
+		text[sizeof(text) - 1] = 0x00;
+		redraw();
+	}
+	void textcolor (Fl_Color c) { fg = c; }
+	void textsize (Fl_Fontsize s) { size = s; }
+	void textfont (Fl_Font f) { font = f; }
+
+	void draw (void) {
+		label_cache.draw(text, font, size, fg, color(), FL_DOWN_BOX,
+			x(), y(), w(), h());
+	}
+};
+
+// Meter is a level bar. The empty and the lit scale are each drawn
+// once into an offscreen the first time a meter is shown, after
+// that a meter is two copies: all of the empty one and as much of
+// the lit one as the level says.
+class Meter : public Fl_Widget
+{
+private:
+float val;
+float top;
+static Fl_Offscreen dark;
+static Fl_Offscreen lit;
+static int img_w, img_h;
+
+	// the scale, 12 steps with a gap between
+	static void scale (Fl_Offscreen img, int w, int h, Fl_Color bg, Fl_Color fg) {
+		fl_begin_offscreen(img);
+		fl_draw_box(FL_DOWN_BOX, 0, 0, w, h, bg);
+		int step = (w - 4) / 12;
+		fl_color(fg);
+		for (int i = 0; i < 12; i++) {
+			fl_rectf(2 + i * step + 1, 2, step - 1, h - 4);
+		}
+		fl_end_offscreen();
+	}
+public:
+	Meter(int wx, int wy, int ww, int wh, float mx) :
+	Fl_Widget(wx, wy, ww, wh, "")
+	{
+		val = 0.0;
+		top = mx;
+	}
+
+	void value (float v) {
+		if (v != val) {
+			val = v;
+			redraw();
+		}
+	}
+
+	void draw (void) {
+		if (!dark || img_w != w() || img_h != h()) {
+			if (dark) {
+				fl_delete_offscreen(dark);
+				fl_delete_offscreen(lit);
+			}
+			img_w = w();
+			img_h = h();
+			dark = fl_create_offscreen(img_w, img_h);
+			lit = fl_create_offscreen(img_w, img_h);
+			scale(dark, img_w, img_h, color(), 58);
+			scale(lit, img_w, img_h, color(), FL_YELLOW);
+		}
+		int lw = (int) ((float) (w() - 4) * val / top + 0.5f);
+		fl_copy_offscreen(x(), y(), w(), h(), dark, 0, 0);
+		if (lw > 0) {
+			fl_copy_offscreen(x() + 2, y(), lw, h(), lit, 2, 0);
+		}
+	}
+};
+Fl_Offscreen Meter::dark = 0;
+Fl_Offscreen Meter::lit = 0;
+int Meter::img_w = 0;
+int Meter::img_h = 0;
+
+// MeterSpark is the recent meter history of one strip as a little bar
+// graph that scrolls left. The graph lives in an offscreen used as a
+// ring: each frame only the columns that are new get drawn into it,
+// then it goes on screen as two copies, the oldest part first.
+class MeterSpark : public Fl_Widget
+{
+private:
+int ch;
+int cw;		// pixels per column
+int ncols;	// columns shown
+Fl_Offscreen ring;
+bool fresh;	// nothing in ring yet
+uint64_t drawn;	// newest column in ring
+uint32_t seen;
+
+	// one column into ring, must be inside fl_begin_offscreen
+	void draw_col (uint64_t col) {
+		unsigned char v = meter_history.column(ch, col);
+		int cx = (int) (col % ncols) * cw;
+		int bh = (h() * (v & ~MH_OVER) + MH_TOP - 1) / MH_TOP;
+		fl_color(color());
+		fl_rectf(cx, 0, cw, h() - bh);
+		if (bh) {
+			fl_color((v & MH_OVER) ? FL_RED : FL_YELLOW);
+			fl_rectf(cx, h() - bh, cw, bh);
+		}
+	}
+public:
+	MeterSpark(int wx, int wy, int ww, int wh, int channel) :
+	Fl_Widget(wx, wy, ww, wh, "")
+	{
+		ch = channel;
+		cw = sz(0.5) > 0 ? sz(0.5) : 1;
+		ncols = ww / cw;
+		if (ncols > MH_COLUMNS) {
+			ncols = MH_COLUMNS;
+		}
+		ring = 0;
+		fresh = true;
+		drawn = 0;
+		seen = 0;
+	}
+
+	// once a frame, only redraws if the history moved
+	void update (void) {
+		if (meter_history.changes(ch) != seen) {
+			seen = meter_history.changes(ch);
+			redraw();
+		}
+	}
+
+	void draw (void) {
+		if (!ring) {
+			ring = fl_create_offscreen(ncols * cw, h());
+			fresh = true;
+		}
+		uint64_t head = meter_history.head();
+		// the last column we drew may have got louder since, and
+		// meter values that were read late can change older ones
+		uint64_t from = drawn;
+		uint64_t late = meter_history.take_oldest(ch);
+		if (late < from) {
+			from = late;
+		}
+		if (fresh || head - from >= (uint64_t) ncols) {
+			from = head + 1 >= (uint64_t) ncols ? head + 1 - ncols : 0;
+		}
+		fl_begin_offscreen(ring);
+		for (uint64_t c = from; c <= head; c++) {
+			draw_col(c);
+		}
+		fl_end_offscreen();
+		drawn = head;
+		fresh = false;
+		// oldest column is the one after head
+		int rw = ncols * cw;
+		int split = (int) ((head + 1) % ncols) * cw;
+		fl_copy_offscreen(x(), y(), rw - split, h(), ring, split, 0);
+		if (split) {
+			fl_copy_offscreen(x() + rw - split, y(), split, h(), ring, 0, 0);
+		}
+		if (rw < w()) {
+			fl_color(color());
+			fl_rectf(x() + rw, y(), w() - rw, h());
+		}
+	}
+};
 
 class ChLed : public Fl_Pack
 {
 private:
 int wx, wy;
-Fl_Output *led_R;
-Fl_Output *led_S;
-Fl_Output *led_M;
-Fl_Output *led_W;
+Lamp *led_R;
+Lamp *led_S;
+Lamp *led_M;
+Lamp *led_W;
 Fl_Box *space;
 public:
 
 		ChLed(int wx, int wy) :
-		Fl_Pack(wx, wy, siz * 23, siz * 7, "")
+		Fl_Pack(wx, wy, sz(23), sz(7), "")
 		{
 		color(57);
 		type(Fl_Pack::HORIZONTAL);
 		begin();
-			space = new Fl_Box (0, 0, siz + 1, siz * 7, "");
+			space = new Fl_Box (0, 0, sz(1) + 1, sz(7), "");
 			space->color (56);
-			led_R = new Fl_Output (0, 0, siz * 5, siz * 7, "");
+			led_R = new Lamp (0, 0, sz(5), sz(7));
 			led_R->color(57);
-			led_S = new Fl_Output (0, 0, siz * 5, siz * 7, "");
+			led_S = new Lamp (0, 0, sz(5), sz(7));
 			led_S->color(57);
-			led_M = new Fl_Output (0, 0, siz * 5, siz * 7, "");
+			led_M = new Lamp (0, 0, sz(5), sz(7));
 			led_M->color(57);
-			led_W = new Fl_Output (0, 0, siz * 5, siz * 7, "");
+			led_W = new Lamp (0, 0, sz(5), sz(7));
 			led_W->color(57);
 			led_W->textcolor (FL_RED);
 		end();
@@ -145,6 +384,87 @@ void peak (bool pk) {
 
 };
 
+// StripText shows one 7 character cell of the scribble strip. It
+// looks like the Fl_Output it replaces but draws from label_cache.
+class StripText : public Fl_Widget
+{
+private:
+char text[8];
+public:
+	StripText(int wx, int wy, int ww, int wh) :
+	Fl_Widget(wx, wy, ww, wh, "")
+	{
+		text[0] = 0x00;
+		box(FL_DOWN_BOX);
+	}
+
+	void value (const char* line) {
+		if (strncmp(text, line, 7)) {
+			strncpy(text, line, 7);
+			text[7] = 0x00;
+			redraw();
+		}
+	}
+
+	void draw (void) {
+		label_cache.draw(text, 4, sz(5), 181, color(), FL_DOWN_BOX,
+			x(), y(), w(), h());
+	}
+};
+
+// VPot draws the 11 LED ring of a vpot as a row with the center LED
+// at the end. It is only asked to redraw once a frame at most.
+class VPot : public Fl_Widget
+{
+private:
+unsigned char val;
+public:
+	VPot(int wx, int wy, int ww, int wh) :
+	Fl_Widget(wx, wy, ww, wh, "")
+	{
+		val = 0;
+	}
+
+	// raw ring cc value from the daw
+	void value (unsigned char v) {
+		if (v != val) {
+			val = v;
+			redraw();
+		}
+	}
+
+	void draw (void) {
+		int mode = (val >> 4) & 0x03;
+		int pos = val & 0x0f;
+		int segw = w() / 12;
+		draw_box(FL_FLAT_BOX, color());
+		for (int i = 1; i < 12; i++) {
+			bool on = false;
+			if (pos && pos < 12) {
+				switch (mode) {
+				case 0: // single dot
+					on = (i == pos);
+					break;
+				case 1: // boost/cut, fill from the middle
+					on = (pos >= 6) ? (i >= 6 && i <= pos) : (i >= pos && i <= 6);
+					break;
+				case 2: // wrap, fill from the left
+					on = (i <= pos);
+					break;
+				case 3: // spread, grow out from the middle
+					on = (abs(i - 6) < pos);
+					break;
+				}
+			}
+			fl_color(on ? 61 : 58);
+			fl_rectf(x() + (i - 1) * segw + 1, y() + 1, segw - 1, h() - 2);
+		}
+		// center LED
+		fl_color((val & 0x40) ? FL_RED : 58);
+		fl_rectf(x() + 11 * segw + 1, y() + 1, segw - 1, h() - 2);
+	}
+};
+
 // channel combines a channel LED pack with a meter and chanel display
 class Chan : public Fl_Pack
 {
@@ -152,34 +472,42 @@ private:
 int wx, wy;
 int loopcount = 0;
 char old_lv;
-Fl_Progress *meter;
-Fl_Output *top_disp;
-Fl_Output *low_disp;
+Meter *meter;
+Fl_Progress *fader_pos;
+VPot *vpot_ring;
+StripText *top_disp;
+StripText *low_disp;
 ChLed *chled;
+MeterSpark *spark;
 public:
-	Chan(int wx, int wy) :
-	Fl_Pack(wx, wy, siz * 23, siz * 8, "")
+	Chan(int wx, int wy, int ch) :
+	Fl_Pack(wx, wy, sz(23), sz(8), "")
 	{
 		color(57);
 		begin();
-			top_disp = new Fl_Output (0, 0, siz * 23, siz * 7, "");
+			top_disp = new StripText (0, 0, sz(23), sz(7));
 			top_disp->color(57);
-			top_disp->textfont(4);
-			top_disp->textcolor(181);
-			top_disp->textsize(siz * 5);
-			low_disp = new Fl_Output (0, 0, siz * 23, siz * 7, "");
+			low_disp = new StripText (0, 0, sz(23), sz(7));
 			low_disp->color(57);
-			low_disp->textfont(4);
-			low_disp->textcolor(181);
-			low_disp->textsize(siz * 5);
 			chled = new ChLed(0, 0);
 			chled->color(57); // do I need this?
-			meter = new Fl_Progress(0, 0, siz * 20, siz * 4, "");
+			meter = new Meter(0, 0, sz(20), sz(4), 12.0);
 			meter->color(57);
-			meter->maximum(12.0);
-			meter->minimum(0.0);
 			meter->value(12.0);
 			old_lv = 12;
+			vpot_ring = new VPot(0, 0, sz(23), sz(3));
+			vpot_ring->color(57);
+			fader_pos = new Fl_Progress(0, 0, sz(23), sz(3), "");
+			fader_pos->color(57);
+			fader_pos->selection_color(58);
+			fader_pos->maximum(16383.0);
+			fader_pos->minimum(0.0);
+			fader_pos->value(0.0);
+			spark = 0;
+			if (meter_hist) {
+				spark = new MeterSpark(0, 0, sz(23), sz(6), ch);
+				spark->color(56);
+			}
 		end();
 		show();
 	}
@@ -201,6 +529,16 @@ public:
 	void sel (bool sest) {chled->sel(sest);}
 	void peak (bool pk) {chled->peak(pk);}
 
+	// fader feedback, 14 bit pitchbend value
+	void fader (unsigned short pos) {
+		fader_pos->value((float) pos);
+	}
+
+	// vpot LED ring
+	void vpot (unsigned char val) {
+		vpot_ring->value(val);
+	}
+
 	// This sets the meter level
 	void level (char lv) {
 		if (lv >= old_lv) {
@@ -213,6 +551,13 @@ public:
 		}
 	}
 
+	// scroll the meter history along if it moved
+	void history (void) {
+		if (spark) {
+			spark->update();
+		}
+	}
+
 	// This decrements the meter to provide fall off
 	void decr (void) {
 		if (old_lv) {
@@ -233,66 +578,66 @@ class Transport : public Fl_Pack
 {
 private:
 int wx, wy;
-Fl_Output *RW;
-Fl_Output *FF;
-Fl_Output *Stop;
-Fl_Output *Play;
-Fl_Output *Rec;
-Fl_Output *Solo;
-Fl_Output *Assign;
-Fl_Output *Flip;
-Fl_Output *View;
+Lamp *RW;
+Lamp *FF;
+Lamp *Stop;
+Lamp *Play;
+Lamp *Rec;
+Lamp *Solo;
+Lamp *Assign;
+Lamp *Flip;
+Lamp *View;
 public:
 
 		Transport(int wx, int wy) :
-		Fl_Pack(wx, wy, siz * 83, siz * 10, "")
+		Fl_Pack(wx, wy, sz(83), sz(10), "")
 		{
 		color(57);
 		type(Fl_Pack::HORIZONTAL);
 		begin();
-			RW = new Fl_Output(1, 1, siz * 8, siz * 10, "");
+			RW = new Lamp(1, 1, sz(8), sz(10));
 			RW->color(58);
-			RW->textsize(siz * 6);
+			RW->textsize(sz(6));
 			RW->textcolor(57);
 			RW->value("◂◂");
-			FF = new Fl_Output(0, 1, siz * 8, siz * 10, "");
+			FF = new Lamp(0, 1, sz(8), sz(10));
 			FF->color(58);
-			FF->textsize(siz * 6);
+			FF->textsize(sz(6));
 			FF->textcolor(57);
 			FF->value("▸▸");
-			Stop = new Fl_Output(0, 1, siz * 8, siz * 10, "");
+			Stop = new Lamp(0, 1, sz(8), sz(10));
 			Stop->color(58);
-			Stop->textsize(siz * 6);
+			Stop->textsize(sz(6));
 			Stop->textcolor(57);
 			Stop->value("■");
-			Play = new Fl_Output(0, 1, siz * 8, siz * 10, "");
+			Play = new Lamp(0, 1, sz(8), sz(10));
 			Play->color(58);
-			Play->textsize(siz * 6);
+			Play->textsize(sz(6));
 			Play->textcolor(57);
 			Play->value("▶");
-			Rec = new Fl_Output(0, 1, siz * 8, siz * 10, "");
+			Rec = new Lamp(0, 1, sz(8), sz(10));
 			Rec->color(105);
-			Rec->textsize(siz * 5);
+			Rec->textsize(sz(5));
 			Rec->textcolor(106);
 			Rec->value("⬤");
-			Solo = new Fl_Output(0, 1, siz * 17, siz * 10, "");
+			Solo = new Lamp(0, 1, sz(17), sz(10));
 			Solo->color(105);
-			Solo->textsize(siz * 6);
+			Solo->textsize(sz(6));
 			Solo->textcolor(106);
 			Solo->value("Solo");
-			Assign = new Fl_Output(0, 1, siz * 38, siz * 10, "");
+			Assign = new Lamp(0, 1, sz(38), sz(10));
 			Assign->color(58);
-			Assign->textsize(siz * 6);
+			Assign->textsize(sz(6));
 			Assign->textcolor(61);
 			Assign->value("");
-			Flip = new Fl_Output(0, 1, siz * 14, siz * 10, "");
+			Flip = new Lamp(0, 1, sz(14), sz(10));
 			Flip->color(58);
-			Flip->textsize(siz * 6);
+			Flip->textsize(sz(6));
 			Flip->textcolor(57);
 			Flip->value("Flip");
-			View = new Fl_Output(0, 1, siz * 17, siz * 10, "");
+			View = new Lamp(0, 1, sz(17), sz(10));
 			View->color(58);
-			View->textsize(siz * 6);
+			View->textsize(sz(6));
 			View->textcolor(57);
 			View->value("View");
 		end();
@@ -433,6 +778,280 @@ void inst (bool pk) {
 
 };
 
+// the master lamps that only fit when the clock is off, they go
+// where the clock would be, two rows of eight
+static const struct {
+	unsigned char note;
+	const char* name;
+} panel_lamps[16] = {
+	{ 0x4a, "Read" }, { 0x4b, "Write" }, { 0x4c, "Trim" }, { 0x4d, "Touch" },
+	{ 0x4e, "Latch" }, { 0x4f, "Group" }, { 0x50, "Save" }, { 0x51, "Undo" },
+	{ 0x54, "Mark" }, { 0x55, "Nudge" }, { 0x56, "Cycle" }, { 0x57, "Drop" },
+	{ 0x58, "Repl" }, { 0x59, "Click" }, { 0x64, "Zoom" }, { 0x65, "Scrub" },
+};
+
+// LampPanel is all of panel_lamps in one widget. Each lamp is a
+// label_cache copy like Lamp, but when one changes only the lamps
+// that changed are copied again, not the whole panel.
+class LampPanel : public Fl_Widget
+{
+private:
+uint16_t on;
+uint16_t changed;
+
+	void draw_cell (int i) {
+		int cw = w() / 8;
+		int ch = h() / 2;
+		label_cache.draw(panel_lamps[i].name, 0, sz(3.5),
+			((on >> i) & 1) ? 61 : 57, 58, FL_DOWN_BOX,
+			x() + (i & 7) * cw, y() + (i >> 3) * ch, cw, ch);
+	}
+public:
+	LampPanel(int wx, int wy, int ww, int wh) :
+	Fl_Widget(wx, wy, ww, wh, "")
+	{
+		on = 0;
+		changed = 0;
+	}
+
+	// which panel lamp a note is, -1 for none
+	static int cell (int note) {
+		for (int i = 0; i < 16; i++) {
+			if (panel_lamps[i].note == note) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	void lamp (int i, bool st) {
+		uint16_t bit = 1u << i;
+		if (((on & bit) != 0) == st) {
+			return;
+		}
+		on ^= bit;
+		changed |= bit;
+		damage(FL_DAMAGE_USER1);
+	}
+
+	void draw (void) {
+		if (damage() & ~FL_DAMAGE_USER1) {
+			// exposed, do it all. The cells may not fill the
+			// whole widget after rounding.
+			fl_color(color());
+			fl_rectf(x(), y(), w(), h());
+			changed = 0xffff;
+		}
+		for (int i = 0; i < 16; i++) {
+			if (changed & (1u << i)) {
+				draw_cell(i);
+			}
+		}
+		changed = 0;
+	}
+};
+
+// the widgets the midi parser writes to
+Chan *chan[8];
+Transport *transport;
+LampPanel *master_lamps;
+Fl_Output *disp2;
+Fl_Output *time1;
+Fl_Progress *master_fader;
+
+// everything the daw has told us, parser writes, show_surface reads
+Surface surface;
+
+// where the surface is saved between runs, empty for not at all
+char state_file[1024];
+uint32_t saved_gen (0);
+
+// optional copy of the surface for other displays
+OscOut osc;
+
+// put one lamp on the screen
+void show_lamp (int note, bool on)
+{
+	if( note < 8 ) {
+		if (!on) {
+			chan[note]->rec(false);
+		} else {
+			chan[note]->rec(true);
+		}
+	} else if ( note < 16 ) {
+		/* Lamps 8 - 15 are PFL (Solo?) buttons */
+		if (!on) {
+			chan[note - 8]->sol(false);
+		} else {
+			chan[note - 8]->sol(true);
+		}
+	} else if ( note < 24 ) {
+		/* Lamps 16 - 23 are Mute buttons */
+		if (!on) {
+			chan[note - 16]->mute(false);
+		} else {
+			chan[note - 16]->mute(true);
+		}
+	} else if ( note < 32 ) {
+		/* Lamps 24 - 31 are channel select indicators */
+		if (!on) {
+			chan[note - 24]->sel(false);
+		} else {
+			chan[note - 24]->sel(true);
+		}
+	} else if (master) { // anything else is a master
+		switch (note) {
+		case 0x5b:
+			// rewind «⏪
+			transport->rw(on);
+			break;
+		case 0x5c:
+			// fwd »⏩
+			transport->ff(on);
+			break;
+		case 0x5d:
+			transport->stop(on);
+			// stop∎■⬛
+			break;
+		case 0x5e:
+			// play‣▶
+			transport->play(on);
+			break;
+		case 0x5f:
+			// master record enable
+			transport->rec(on);
+			break;
+		case 0x73:
+			transport->solo(on);
+			// solo
+			break;
+		case 0x32:
+			transport->flip(on);
+			// Flip
+			break;
+		case 0x33:
+			// global view
+			transport->view(on);
+			break;
+		case 0x28:
+			// track (Trim)
+			transport->track(on);
+			break;
+		case 0x29:
+			// Send
+			transport->send(on);
+			break;
+		case 0x2a:
+			// Pan
+			transport->pan(on);
+			break;
+		case 0x2b:
+			// Plug-in
+			transport->plug(on);
+			break;
+		case 0x2c:
+			// EQ
+			transport->eq(on);
+			break;
+		case 0x2d:
+			// Instrument
+			transport->inst(on);
+			break;
+		default:
+			break;
+		}
+		if (!shotime) {
+			// if time is off we have room for the rest
+			int i = LampPanel::cell(note);
+			if (i >= 0) {
+				master_lamps->lamp(i, on);
+			}
+		}
+	}
+}
+// Show whatever changed since last frame. However many messages
+// came in, each control only gets its last value.
+void show_surface (void)
+{
+	TRACE_SPAN("show surface");
+	unsigned int dirty = surface.dirty;
+	surface.dirty = 0;
+	if (!dirty) {
+		return;
+	}
+	for (int x = 0; x < 8; x++) {
+		if (dirty & FADER_DIRTY(x)) {
+			chan[x]->fader(surface.fader[x]);
+		}
+		if (dirty & VPOT_DIRTY(x)) {
+			chan[x]->vpot(surface.vpot[x]);
+		}
+	}
+	if ((dirty & FADER_DIRTY(8)) && master) {
+		master_fader->value((float) surface.fader[8]);
+	}
+	if (dirty & LINE1_DIRTY) {
+		for ( int x=0; x < 8; x++) {
+			char text[8];
+			memcpy (text, &surface.line1[x * 7], 7);
+			text[7] = 0x00;
+			chan[x]->top(text);
+		}
+	}
+	if (dirty & LINE2_DIRTY) {
+		for ( int x=0; x < 8; x++) {
+			char text[8];
+			memcpy (text, &surface.line2[x * 7], 7);
+			text[7] = 0x00;
+			chan[x]->low(text);
+		}
+	}
+	if ((dirty & ASSIGN_DIRTY) && master) {
+		char text[3];
+		memcpy (text, surface.assign, 2);
+		text[2] = 0x00;
+		disp2->value(text);
+	}
+	if ((dirty & TIME_DIRTY) && shotime) {
+		char text[14];
+		memcpy (text, surface.timecode, 13);
+		// insert | for beats or : for time.
+		text[3] = surface.tm_bt;
+		text[6] = surface.tm_bt;
+		text[9] = surface.tm_bt;
+		text[13] = 0x00;
+		time1->value(text);
+	}
+	if (dirty & LAMP_DIRTY) {
+		// only the lamps that are not as shown, a lamp that went
+		// on and off again in one frame is left alone
+		for (int w = 0; w < 2; w++) {
+			uint64_t diff = surface.lamp[w] ^ surface.lamp_shown[w];
+			surface.lamp_shown[w] = surface.lamp[w];
+			while (diff) {
+				int note = w * 64 + __builtin_ctzll(diff);
+				diff &= diff - 1;
+				show_lamp(note, surface.lamp_on(note));
+			}
+		}
+	}
+}
+
+// long only options
+enum {
+	OPT_LATENCY_REPORT = 256,
+	OPT_LATENCY_OVERLAY,
+	OPT_TRACE,
+	OPT_STATE_FILE,
+	OPT_NO_STATE,
+	OPT_RESYNC,
+	OPT_OSC,
+	OPT_PROTOCOL,
+	OPT_SCALE,
+	OPT_STARTUP_PROFILE,
+	OPT_METER_HISTORY,
+	OPT_SYSLOG,
+};
 
 static int usage() {
 	printf(
@@ -445,7 +1064,19 @@ static int usage() {
 	"        -s, --small             Make it smaller\n"
 	"        -x <x>                  Place mcpdisp at x position\n"
 	"        -y <y>                  place mcpdisp at y position\n"
-	"        -V, --version           Show version information\n\n"
+	"        -V, --version           Show version information\n"
+	"        --latency-report        Print event to pixel latency on exit\n"
+	"        --latency-overlay       Show event to pixel latency in the window\n"
+	"        --trace <file>          Record a chrome trace, written on exit or SIGUSR1\n"
+	"        --state-file <file>     Save and restore the display using file\n"
+	"        --no-state              Do not save or restore the display\n"
+	"        --resync                Add a _to_daw port and ask the daw for a full refresh\n"
+	"        --osc <[host:]port>     Send display changes as OSC (default host 127.0.0.1)\n"
+	"        --protocol <mcp|hui>    What the daw speaks (default mcp)\n"
+	"        --scale <factor>        Scale the display, 1.5 for half again as big\n"
+	"        --startup-profile       Print how long each step of starting took\n"
+	"        --meter-history         Show the last few seconds of meter under each strip\n"
+	"        --syslog                Send midi overrun messages to syslog, not stderr\n\n"
 	, VERSION);
 
     return 0;
@@ -453,93 +1084,473 @@ static int usage() {
 
 
 
-// Jack RT process function
-int process(jack_nframes_t nframes, void *arg)
+// parse one complete mcp message and hand it to the widgets
+void mcp_message (const unsigned char* msg, size_t len, uint64_t stamp, void* arg)
 {
-	uint i;
-	char sendstring[127];
-	void* port_buf = jack_port_get_buffer(input_port, nframes);
-	void* thru_buf = jack_port_get_buffer(thru_port, nframes);
-	unsigned char* buffer;
-	jack_midi_clear_buffer(thru_buf);
-
-	jack_midi_event_t in_event;
-	jack_nframes_t event_count = jack_midi_get_event_count(port_buf);
-	if(event_count > 0)
-	{
-		for(i=0; i<event_count; i++)
-		{
-			jack_midi_event_get(&in_event, port_buf, i);
-			// send event to through here
-			buffer = jack_midi_event_reserve(thru_buf, 0, in_event.size);
-
-			unsigned int availableWrite = jack_ringbuffer_write_space(midibuffer);
-			if (availableWrite > in_event.size) {
-				sendstring[0] = in_event.size;
-				memcpy (&sendstring[1], in_event.buffer, in_event.size);
-				unsigned int written = jack_ringbuffer_write( midibuffer, (const char*) sendstring, in_event.size + 1);
-				if (written != in_event.size + 1) {
-					// only for debug
-					//cout << "ERROR! Partial midibuffer write\n";
+	TRACE_SPAN("decode");
+	if (measure) {
+		latency.event(Latency::classify(msg, len), stamp);
+	}
+	switch ((unsigned char) msg[0]) {
+	case 0xf0:
+		if (len < 8) {
+			// too short to be anything we know
+			break;
+		}
+		if (msg[5] == 0x12) {
+			// display stuff
+			// offset 0 - 55 is the top line, 56 - 111 the bottom.
+			// text may be any length now so take a char at a time,
+			// anything that runs off the end is thrown away
+			int offset = msg[6];
+			for (size_t i = 7; i < len - 1; i++, offset++) {
+				surface.set_text(offset, msg[i]);
+			}
+		} else if (msg[5] == 0x10 && len >= 17) {
+			// time code all at once Should be a function
+			int p = 12;
+			for (int i = 6; i < 16; i++) {
+				char digit = msg[i] & 0x03;
+				if (digit == 0x00) {
+					digit = 0x20;
 				}
-			} else {
-				// only for debug
-				// cout << "midibuffer full skipping\n";
+				surface.set_time(p, digit);
+				if (p == 10 || p == 7 || p == 4) {
+					// skip position 9,6 and 3
+					p--;
+				}
+				p--;
 			}
-			memcpy (buffer, in_event.buffer, in_event.size);
 		}
+		break;
+	case 0x90:
+		// Lamps, only note which are on here. show_lamp() sorts
+		// out which widget each one belongs to.
+		surface.set_lamp(msg[1], msg[2] != 0);
+		// these next two are really shotime only, but don't hurt anything
+		if (msg[1] == 0x72 && msg[2] == 0) {
+			// time display is time
+			surface.set_tm_bt(':');
+		} else if (msg[1] == 0x71 && msg[2] == 0) {
+			// time display is beats and bars
+			surface.set_tm_bt('|');
+		}
+		break;
+	case 0xe0:
+	case 0xe1:
+	case 0xe2:
+	case 0xe3:
+	case 0xe4:
+	case 0xe5:
+	case 0xe6:
+	case 0xe7:
+	case 0xe8:
+		// fader feedback, 8 is master. Only store it here, these
+		// come far faster than we want to draw
+		surface.set_fader(msg[0] & 0x0f, (msg[2] << 7) | msg[1]);
+		break;
+	case 0xd0:
+		// this is meters (make function)
+		int chm; // meter channel
+		int mval; // meter value
+		// divide into chm and mval
+		mval = msg[1] & 0x0f;
+		chm = msg[1] >> 4;
+		surface.set_meter(chm, mval);
+		if (meter_hist) {
+			meter_history.add(chm, mval, stamp);
+		}
+		if (mval == 0x0e) {
+			chan[(int)chm]->peak(true);
+			chan[(int)chm]->level(0x0c);
+		} else if (mval == 0x0f) {
+			chan[(int)chm]->peak(false);
+		} else {
+			chan[(int)chm]->level(mval);
+		}
+		break;
+	case 0xb0:
+		// make function
+		if (msg[1] >= 0x30 && msg[1] < 0x38) {
+			// vpot LED rings
+			surface.set_vpot(msg[1] - 0x30, msg[2]);
+			break;
+		}
+		if (master) {
+			// timecode
+			if (msg[1] & 0x40) {
+				char data1 = 0x20;
+				if( msg[2] < 0x20 ) {
+					data1 = msg[2] + 0x40;
+					// cludge because some DAWs send @ instead of space
+					if(data1 == 0x40) data1 = 0x20;
+				} else {
+					data1 = msg[2];
+				}
+				switch (msg[1]) {
+				case 0x4b:	// left assign char
+					surface.set_assign(0, data1);
+					break;
+				case 0x4a:	// left assign char
+					surface.set_assign(1, data1);
+					break;
+				// timecode stuff, should maybe not be checked
+				// for if not used, if time turned off, no data sent.
+				case 0x49:	// time digit 10 (msb)
+					surface.set_time(0, data1);
+					break;
+				case 0x48:	// time digit 9
+					surface.set_time(1, data1);
+					break;
+				case 0x47:	// time digit 8
+					surface.set_time(2, data1);
+					break;
+				case 0x46:	// time digit 7
+					surface.set_time(4, data1);
+					break;
+				case 0x45:	// time digit 6
+					surface.set_time(5, data1);
+					break;
+				case 0x44:	// time digit 5
+					surface.set_time(7, data1);
+					break;
+				case 0x43:	// time digit 4
+					surface.set_time(8, data1);
+					break;
+				case 0x42:	// time digit 3
+					surface.set_time(10, data1);
+					break;
+				case 0x41:	// time digit 2
+					surface.set_time(11, data1);
+					break;
+				case 0x40:	// time digit 1 (lsb)
+					surface.set_time(12, data1);
+					break;
+				default:
+					break;
+				}
+			}
+
+		}
+
+	default:
+		break;
 	}
+}
+
+// RtCore's way in and out of jack, one of these per period
+struct JackIo {
+	void* in;
+	void* thru_buf;
+	void* daw_buf;
+	jack_nframes_t cycle;	// start of this period
+
+	RT_INLINE uint32_t count (void) {
+		return jack_midi_get_event_count(in);
+	}
+	RT_INLINE void get (jack_midi_event_t* ev, uint32_t i) {
+		jack_midi_event_get(ev, in, i);
+	}
+	RT_INLINE unsigned char* thru (size_t size) {
+		return jack_midi_event_reserve(thru_buf, 0, size);
+	}
+	RT_INLINE bool daw (void) {
+		return daw_buf != 0;
+	}
+	RT_INLINE void to_daw (const unsigned char* msg, size_t len) {
+		jack_midi_event_write(daw_buf, 0, msg, len);
+	}
+	RT_INLINE jack_time_t stamp (jack_nframes_t time) {
+		return jack_frames_to_time(client, cycle + time);
+	}
+};
+
+RtCore<JackIo> rt_core;
+
+// Jack RT process function
+int process(jack_nframes_t nframes, void *arg)
+{
+	TRACE_THREAD("jack process");
+	TRACE_SPAN("process");
+	JackIo io;
+	io.in = jack_port_get_buffer(input_port, nframes);
+	io.thru_buf = jack_port_get_buffer(thru_port, nframes);
+	jack_midi_clear_buffer(io.thru_buf);
+	io.daw_buf = 0;
+	if (to_daw_port) {
+		io.daw_buf = jack_port_get_buffer(to_daw_port, nframes);
+		jack_midi_clear_buffer(io.daw_buf);
+	}
+	io.cycle = jack_last_frame_time(client);
+	rt_core.period(io);
 	return 0;
 }
 
-// Clean up if someone closes the window
-void close_cb(Fl_Widget*, void*) {
-	printf("Killing child processes..\n");
+// Hand the records waiting in one lane to its decoder, at most max
+// of them (0 for all). The bytes go straight from the ring, which may
+// wrap, so there can be two pieces.
+void drain_lane (jack_ringbuffer_t *lane, MidiDecoder& decoder, int max)
+{
+	int done = 0;
+	while (jack_ringbuffer_read_space(lane) >= sizeof(MidiRec)) {
+		if (max && done++ >= max) {
+			break;
+		}
+		MidiRec rec;
+		jack_ringbuffer_peek(lane, (char*) &rec, sizeof(MidiRec));
+		if (jack_ringbuffer_read_space(lane) < sizeof(MidiRec) + rec.size) {
+			// rest of it not here yet
+			break;
+		}
+		jack_ringbuffer_read_advance(lane, sizeof(MidiRec));
+		jack_ringbuffer_data_t vec[2];
+		jack_ringbuffer_get_read_vector(lane, vec);
+		size_t first = (rec.size < vec[0].len) ? rec.size : vec[0].len;
+		decoder.feed((const unsigned char*) vec[0].buf, first, rec.stamp);
+		if (first < rec.size) {
+			decoder.feed((const unsigned char*) vec[1].buf, rec.size - first, rec.stamp);
+		}
+		jack_ringbuffer_read_advance(lane, rec.size);
+	}
+}
+
+// save the surface if it changed since last time
+void save_state (void)
+{
+	if (state_file[0] && surface.generation != saved_gen) {
+		if (snapshot_save(state_file, &surface)) {
+			saved_gen = surface.generation;
+		}
+	}
+}
+
+void state_cb (void*)
+{
+	save_state();
+	Fl::repeat_timeout(1.0, state_cb);
+}
+
+// anything that needs doing on the way out
+void finish (void)
+{
+	save_state();
+	if (lat_report) {
+		latency.report(stdout);
+	}
+	trace_dump();
+}
+
+// SIGUSR1 asks for a trace dump, done from the main loop
+volatile sig_atomic_t dump_trace = 0;
+void on_usr1(int signum) {
+	dump_trace = 1;
+}
+
+// refresh the latency overlay now and then
+Fl_Box *lat_overlay;
+void overlay_cb (void*)
+{
+	static char text[128];
+	latency.summary(text, sizeof(text));
+	lat_overlay->label(text);
+	lat_overlay->redraw();
+	Fl::repeat_timeout(0.5, overlay_cb);
+}
+
+// Someone connected one of our ports, probably the daw has come back
+// or we have just been patched in. Either way ask for everything.
+void port_connect (jack_port_id_t a, jack_port_id_t b, int connect, void *arg)
+{
+	if (!connect) {
+		return;
+	}
+	jack_port_t *pa = jack_port_by_id(client, a);
+	jack_port_t *pb = jack_port_by_id(client, b);
+	if (pa == input_port || pb == input_port || pa == to_daw_port || pb == to_daw_port) {
+		resync_request = true;
+	}
+}
+
+void jack_shutdown(void *arg)
+{
+	exit(1);
+}
+
+// --startup-profile: when each step of getting going was done,
+// steps come from both the gui and the jack setup thread
+bool start_profile (false);
+struct StartStep {
+	const char* name;
+	uint64_t us;
+};
+StartStep start_steps[16];
+int start_count (0);
+uint64_t start_t0;
+std::mutex start_lock;
+
+static uint64_t mono_us (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void startup_step (const char* name)
+{
+	if (!start_profile) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(start_lock);
+	if (start_count < 16) {
+		start_steps[start_count].name = name;
+		start_steps[start_count].us = mono_us() - start_t0;
+		start_count++;
+	}
+}
+
+void startup_report (void)
+{
+	if (!start_profile) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(start_lock);
+	fprintf(stderr, "startup profile (ms from start of main)\n");
+	for (int i = 0; i < start_count; i++) {
+		fprintf(stderr, "%8.2f  %s\n", start_steps[i].us / 1000.0, start_steps[i].name);
+	}
+	start_count = 0;
+}
+
+// give up on jack and tell the gui why
+static void jack_fail (const char* why)
+{
+	jack_client_close(client);
+	client = 0;
+	jack_error = why;
+}
+
+// Everything to do with getting jack going. This runs in its own
+// thread so the window is up and drawing while jack takes its time,
+// and a missing jack server just means we keep trying. Anything
+// else going wrong is left in jack_error for the gui to report.
+void jack_setup (void)
+{
+	bool told (false);
+	while ((client = jack_client_open (jackname, JackNoStartServer, NULL)) == 0) {
+		if (!told) {
+			std::cout << "Jack server not running? Will keep trying." << std::endl;
+			told = true;
+		}
+		sleep(1);
+	}
+	startup_step("jack client open");
+
+	jack_set_process_callback (client, process, 0);
+
+	jack_on_shutdown (client, jack_shutdown, 0);
+
+	char *jname = jack_get_client_name (client);
+	char pname[64];
+	strcpy (pname, jname);
+	strcat (pname, "_in");
+
+	input_port = jack_port_register (client, pname, JACK_DEFAULT_MIDI_TYPE, (JackPortIsInput | JackPortIsTerminal | JackPortIsPhysical), 0);
+	strcpy (pname, jname);
+	strcat (pname, "_thru");
+	thru_port = jack_port_register (client, pname, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+	// HUI needs a way back to answer pings
+	if (want_to_daw) {
+		strcpy (pname, jname);
+		strcat (pname, "_to_daw");
+		to_daw_port = jack_port_register (client, pname, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+		jack_set_port_connect_callback (client, port_connect, 0);
+	}
+	startup_step("ports registered");
+
+	/* set up midi buffers */
+	for (int l = 0; l < LANES; l++) {
+		midibuffer[l] = jack_ringbuffer_create( lane_size[l] );
+		if (!midibuffer[l] || jack_ringbuffer_mlock(midibuffer[l])) {
+			jack_fail("Error locking midi memory!");
+			return;
+		}
+	}
+	if (!rtlog.open(256)) {
+		jack_fail("Error making the log buffer for the jack thread");
+		return;
+	}
+	for (int l = 0; l < LANES; l++) {
+		rt_core.lane[l] = midibuffer[l];
+	}
+	rt_core.protocol = protocol;
+	rt_core.master = master;
+	rt_core.resync = &resync_request;
+	rt_core.log = &rtlog;
+	startup_step("ring buffers");
+
+	if (jack_activate (client)) {
+		jack_fail("Error cannot activate jack client");
+		return;
+	}
+	startup_step("jack active");
+	// ask for a full display right away, connects will ask again
+	resync_request = true;
+	jack_ready.store(true);
+}
+
+// let go of jack, if we ever got it
+void jack_close (void)
+{
+	if (!jack_ready.load()) {
+		return;
+	}
 	jack_port_unregister(client, input_port);
 	jack_port_unregister(client, thru_port);
+	if (to_daw_port) {
+		jack_port_unregister(client, to_daw_port);
+	}
 	jack_deactivate(client);
-	jack_ringbuffer_free(midibuffer);
+	for (int l = 0; l < LANES; l++) {
+		jack_ringbuffer_free(midibuffer[l]);
+	}
 	jack_client_close(client);
+}
+
+// Clean up if someone closes the window
+void close_cb(Fl_Widget*, void*) {
+	finish();
+	printf("Killing child processes..\n");
+	jack_close();
 
 	printf("Done.\n");
 	exit(0);
 }
 /* Allow SIGTERM to cause graceful termination */
 /* I don't know which of these are actually needed, but it ends nice */
+// only a flag here, saving and reports use stdio and malloc which
+// are not safe in a handler. The main loop does the rest.
+volatile sig_atomic_t quit_now = 0;
 void on_term(int signum) {
-	jack_port_unregister(client, input_port);
-	jack_port_unregister(client, thru_port);
-	jack_deactivate(client);
-	jack_ringbuffer_free(midibuffer);
-	jack_client_close(client);
-	exit(0);
-
-	return;
-}
-
-void jack_shutdown(void *arg)
-{
-	exit(1);
+	quit_now = 1;
 }
 
 int main(int argc, char** argv)
 {
-	char jackname[16];
+	start_t0 = mono_us();
 	int winsz;
 	int win_x = 2000; // default to lower right corner of a single screen
 	int win_y = 1000;
 	bool help (false);
 	bool version (false);
-	line1_in[56] = 0x00;
-	line2_in[56] = 0x00;
-	disp2_in[2] = 0x00;
-	time1_in[13] = 0x00;
-//	strcpy(time1_in, "000|00| 0|000");
-	strcpy(time1_in, "             ");
-	tm_bt = '|';
-	Chan *chan[8];
+	bool overlay (false);
+	bool use_state (true);
+	bool restored (false);
+	// state_file is from the name we asked jack for
+	bool state_guess (false);
+	bool resync (false);
+	float scale (1.0);
+	TRACE_THREAD("gui");
 	char wname[64];
-	Transport *transport;
 
 
     struct option options[] = {
@@ -550,6 +1561,19 @@ int main(int argc, char** argv)
 	{ "xpos", required_argument, 0, 'x' },
 	{ "ypos", required_argument, 0, 'y' },
 	{ "version", no_argument, 0, 'V' },
+	{ "latency-report", no_argument, 0, OPT_LATENCY_REPORT },
+	{ "latency-overlay", no_argument, 0, OPT_LATENCY_OVERLAY },
+	{ "trace", required_argument, 0, OPT_TRACE },
+	{ "state-file", required_argument, 0, OPT_STATE_FILE },
+	{ "no-state", no_argument, 0, OPT_NO_STATE },
+	{ "resync", no_argument, 0, OPT_RESYNC },
+	{ "osc", required_argument, 0, OPT_OSC },
+	{ "protocol", required_argument, 0, OPT_PROTOCOL },
+	{ "scale", required_argument, 0, OPT_SCALE },
+	{ "startup-profile", no_argument, 0, OPT_STARTUP_PROFILE },
+	{ "meter-history", no_argument, 0, OPT_METER_HISTORY },
+	{ "syslog", no_argument, 0, OPT_SYSLOG },
+	{ 0, 0, 0, 0 }
 	};
 
 	while (1) {
@@ -570,7 +1594,7 @@ int main(int argc, char** argv)
 			shotime = true;
 			break;
 		case 's':
-			siz = 2;
+			siz = 2.0;
 			break;
 		case 'x':
 			if (optarg) {
@@ -591,14 +1615,68 @@ int main(int argc, char** argv)
 		case 'V':
 			version = true;
 			break;
+		case OPT_LATENCY_REPORT:
+			measure = true;
+			lat_report = true;
+			break;
+		case OPT_LATENCY_OVERLAY:
+			measure = true;
+			overlay = true;
+			break;
+		case OPT_TRACE:
+			if (!trace_start(optarg)) {
+				std::cout << "Tracing not built in, configure with -Dtracing=true\n";
+			}
+			break;
+		case OPT_STATE_FILE:
+			strncpy(state_file, optarg, sizeof(state_file) - 1);
+			break;
+		case OPT_NO_STATE:
+			use_state = false;
+			break;
+		case OPT_RESYNC:
+			resync = true;
+			break;
+		case OPT_OSC:
+			if (!osc.open(optarg)) {
+				std::cout << "Can't send OSC to " << optarg << std::endl;
+				return -1;
+			}
+			break;
+		case OPT_STARTUP_PROFILE:
+			start_profile = true;
+			break;
+		case OPT_METER_HISTORY:
+			meter_hist = true;
+			break;
+		case OPT_SYSLOG:
+			rtlog.use_syslog();
+			break;
+		case OPT_SCALE:
+			scale = atof(optarg);
+			if (scale < 0.25 || scale > 8.0) {
+				usage();
+				return -1;
+			}
+			break;
+		case OPT_PROTOCOL:
+			if (!strcmp(optarg, "hui")) {
+				protocol = PROTO_HUI;
+			} else if (!strcmp(optarg, "mcp")) {
+				protocol = PROTO_MCP;
+			} else {
+				usage();
+				return -1;
+			}
+			break;
 	    default:
 			usage();
 			return -1;
 		}
 	}
 
-	Fl_Output disp2(siz * 184, 0, siz * 20, siz * 14, "");
-	Fl_Output time1(siz * 204, 0, siz * 110,siz * 14, "");
+	// -s picks the base size, --scale works from that
+	siz *= scale;
 
 	if (help) {
 		return usage();
@@ -614,41 +1692,6 @@ int main(int argc, char** argv)
 		strcpy(jackname, "mcpdisp");
 	}
 
-	if ((client = jack_client_open (jackname, JackNoStartServer, NULL)) == 0)
-	{
-		std::cout << "Jack server not running?" << std::endl;
-		fl_alert ("Jack server not found. Jackd must be running before starting mcpdisp.");
-		return 1;
-	}
-
-	jack_set_process_callback (client, process, 0);
-
-	jack_on_shutdown (client, jack_shutdown, 0);
-
-	char *jname = jack_get_client_name (client);
-	char pname[16];
-	strcpy (pname, jname);
-	strcat (pname, "_in");
-
-	input_port = jack_port_register (client, pname, JACK_DEFAULT_MIDI_TYPE, (JackPortIsInput | JackPortIsTerminal | JackPortIsPhysical), 0);
-	strcpy (pname, jname);
-	strcat (pname, "_thru");
-	thru_port = jack_port_register (client, pname, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
-
-	/* set up midi buffer */
-	midibuffer = jack_ringbuffer_create( 16384 );
-	int res = jack_ringbuffer_mlock(midibuffer);
-	if ( res ) {
-		std::cout << "Error locking midi memory!\n";
-        return -1;
-	}
-
-
-	if (jack_activate (client)) {
-		std::cout << "Error cannot activate client\n";
-		return 1;
-	}
-
 	/* try to end nice on anything
 		one of these makes window close work */
 	signal(SIGTERM, on_term);
@@ -658,51 +1701,132 @@ int main(int argc, char** argv)
 	signal(SIGQUIT, on_term);
 	signal(SIGKILL, on_term);
 	signal(SIGABRT, on_term);
+	signal(SIGUSR1, on_usr1);
 
 
 	strcpy (wname,"Mackie Control Display Emulator - ");
-	// add jack port name to window title
-	strcat (wname, jname);
+	// add jack port name to window title, for now the one we asked for
+	strcat (wname, jackname);
 
-	// lets make a window
+	// lets make a window, master stuff starts where the strips end
+	// which with rounding may not be quite sz(184)
+	int mx = 8 * sz(23);
 	if(master) {
-		winsz = siz * 314;
+		winsz = 8 * sz(23) + sz(130);
 	} else {
-		winsz = siz * 184;
+		winsz = 8 * sz(23);
+	}
+	// strips are as high as their parts, each rounded on its own,
+	// which at some scales is not quite sz(31)
+	int striph = 3 * sz(7) + sz(4) + 2 * sz(3);
+	if (meter_hist) {
+		// history under them
+		striph += sz(6);
+	}
+	int winh = striph;
+	if (overlay) {
+		winh += sz(5);
 	}
-	Fl_Window win (win_x, win_y, winsz, siz * 25, wname);
+	Fl_Window win (win_x, win_y, winsz, winh, wname);
 	win.callback(close_cb);
 	win.color(56);
 		win.begin();
 			for ( int x=0; x < 8; x++) {
-				Chan *led = new Chan((x * siz * 23), 0);
+				Chan *led = new Chan(x * sz(23), 0, x);
 				chan[x] = led;
 			}
 			if(master) {
 				// Two char display
-				win.add(disp2);
-				disp2.color(64);
-				disp2.textfont(5);
-				disp2.textcolor(88);
-				disp2.textsize(siz * 14 - 1);
-				disp2.value(disp2_in);
-				transport = new Transport(siz * 186, siz * 14);
+				disp2 = new Fl_Output(mx, 0, sz(20), sz(14), "");
+				disp2->color(64);
+				disp2->textfont(5);
+				disp2->textcolor(88);
+				disp2->textsize(sz(14) - 1);
+				disp2->value("");
+				transport = new Transport(mx + sz(2), sz(14));
+				master_fader = new Fl_Progress(mx + sz(2), sz(26), sz(126), sz(3), "");
+				master_fader->color(57);
+				master_fader->selection_color(58);
+				master_fader->maximum(16383.0);
+				master_fader->minimum(0.0);
+				master_fader->value(0.0);
 				if(shotime) {
 					// timecode/bar display
-					win.add(time1);
-					time1.color(64);
-					time1.textfont(5);
-					time1.textcolor(88);
-					time1.textsize(siz * 14 - 1);
-					time1.value(time1_in);
+					time1 = new Fl_Output(mx + sz(20), 0, sz(110),sz(14), "");
+					time1->color(64);
+					time1->textfont(5);
+					time1->textcolor(88);
+					time1->textsize(sz(14) - 1);
+					time1->value("");
 				} else {
 					// stuff that only shows when time doesn't
+					master_lamps = new LampPanel(mx + sz(20), 0, sz(110), sz(14));
+					master_lamps->color(56);
 				}
 			}
 
+			if (overlay) {
+				lat_overlay = new Fl_Box(0, striph, winsz, sz(5), "");
+				lat_overlay->box(FL_FLAT_BOX);
+				lat_overlay->color(56);
+				lat_overlay->labelcolor(181);
+				lat_overlay->labelfont(4);
+				lat_overlay->labelsize(sz(4));
+				lat_overlay->align(FL_ALIGN_LEFT | FL_ALIGN_INSIDE);
+				Fl::add_timeout(0.5, overlay_cb);
+			}
 		win.end();
-	win.show ();
 
+	if (use_state) {
+		// show what we had last time until the daw tells us better.
+		// The default file goes by the name jack gives us, so two
+		// extenders don't share one. Until jack says, guess it gives
+		// us the name we asked for, it mostly does.
+		if (!state_file[0]) {
+			snapshot_default(state_file, sizeof(state_file), jackname);
+			state_guess = true;
+		}
+		if (snapshot_load(state_file, &surface)) {
+			show_surface();
+			restored = true;
+		}
+		// nothing changes to be saved until jack is up, by then the
+		// file name is right
+		Fl::add_timeout(1.0, state_cb);
+	} else {
+		state_file[0] = 0x00;
+	}
+	if (!restored) {
+		// something to look at until jack and the daw turn up
+		chan[0]->top((char*) "waiting");
+		chan[1]->top((char*) "for");
+		chan[2]->top((char*) "jack");
+	}
+	startup_step("window built");
+	win.show ();
+	// get the window mapped and drawn before anything else
+	Fl::check();
+	startup_step("window shown");
+
+	// jack gets going on its own time
+	want_to_daw = resync || protocol == PROTO_HUI;
+	std::thread(jack_setup).detach();
+	bool jack_seen (false);
+
+	// one decoder per lane, each lane is its own midi stream. HUI goes
+	// through a translator first and comes out as mcp.
+	HuiDecoder hui(mcp_message);
+	MidiDecoder::msg_cb parse = mcp_message;
+	void* parse_arg = 0;
+	if (protocol == PROTO_HUI) {
+		parse = HuiDecoder::message;
+		parse_arg = &hui;
+	}
+	MidiDecoder decoder[LANES] = {
+		MidiDecoder(parse, parse_arg),
+		MidiDecoder(parse, parse_arg),
+		MidiDecoder(parse, parse_arg)
+	};
 
 	/* run until interrupted */
 	while(1)
@@ -711,324 +1835,89 @@ int main(int argc, char** argv)
 		// meters to go from FS to 0 in 1.8 seconds
 		// but we now count to 100 so we can run this loop more often
 		Fl::wait(.003);
-		// need to make sure we get all the the midi events
-		int availableMidi (1);
-		while (availableMidi) {
-		// make sure there is at least one byte available
-		availableMidi = jack_ringbuffer_read_space(midibuffer);
-		if( availableMidi > 0 ) {
-			char bytes (0);
-			// just peek at it in case read space is < bytes
-			int read = jack_ringbuffer_peek(midibuffer, &bytes, 1 );
-			if (read) {
-				// this is painful need to make function calls for each event type
-				availableMidi = jack_ringbuffer_read_space(midibuffer);
-				if( availableMidi >= bytes ) {
-					// first read one byte to to set pointer then read data
-					int read = jack_ringbuffer_read(midibuffer, &bytes, 1 );
-					read = jack_ringbuffer_read(midibuffer, (char*)midichunk, bytes);
-					if (read == bytes) {
-						// parse events next
-						switch ((unsigned char) midichunk[0]) {
-						case 0xf0:
-							if (midichunk[5] == 0x12) {
-								// display stuff (should be a function)
-								bool line1 = false;
-								bool line2 = false;
-								int offset = midichunk[6];
-								if (offset < 56) {
-									if ((bytes - 8 + offset) < 57) {
-										memcpy(&line1_in[offset], &midichunk[7], bytes - 8);
-										line1 = true;
-									} else {
-										memcpy(&line1_in[offset], &midichunk[7], 56 - offset);
-										line1 = true;
-										memcpy(&line2_in[0], &midichunk[7 + (55 - offset)], bytes - (56 - offset));
-										line2 = true;
-									}
-
-								} else {
-									offset = offset - 56;
-									if ((bytes - 8 + offset) < 57) {
-										memcpy(&line2_in[offset], &midichunk[7], bytes - 8);
-										line2 = true;
-									} else {
-										memcpy(&line2_in[offset], &midichunk[7], 56 - offset);
-										line2 = true;
-									}
-								}
-								if (line1) {
-									for ( int x=0; x < 8; x++) {
-										char text[8];
-										memcpy (text, &line1_in[x * 7], 7);
-										text[7] = 0x00;
-										chan[x]->top(text);
-									}
-								}
-								if (line2) {
-									for ( int x=0; x < 8; x++) {
-										char text[8];
-										memcpy (text, &line2_in[x * 7], 7);
-										text[7] = 0x00;
-										chan[x]->low(text);
-									}
-								}
-							} else if (midichunk[5] == 0x10) {
-								// time code all at once Should be a function
-								int p = 12;
-								for (int i = 6; i < 16; i++) {
-									time1_in[p] = midichunk[i] & 0x03;
-									if (time1_in[p] == 0x00) {
-										time1_in[p] = 0x20;
-									}
-									if (p == 10 || p == 7 || p == 4) {
-										// skip position 9,6 and 3
-										p--;
-									}
-									p--;
-								}
-							}
-							break;
-						case 0x90:
-							// now display "Lamps"
-							//these are button events (make function)
-							if( midichunk[1] < 8 ) {
-								if (midichunk[2] == 0) {
-									chan[(int) midichunk[1]]->rec(false);
-								} else {
-									chan[(int)midichunk[1]]->rec(true);
-								}
-							} else if ( midichunk[1] < 16 ) {
-								/* Lamps 8 - 15 are PFL (Solo?) buttons */
-								if (midichunk[2] == 0) {
-									chan[(int) midichunk[1] - 8]->sol(false);
-								} else {
-									chan[(int) midichunk[1] - 8]->sol(true);
-								}
-							} else if ( midichunk[1] < 24 ) {
-								/* Lamps 16 - 23 are Mute buttons */
-								if (midichunk[2] == 0) {
-									chan[(int) midichunk[1] - 16]->mute(false);
-								} else {
-									chan[(int) midichunk[1] - 16]->mute(true);
-								}
-							} else if ( midichunk[1] < 32 ) {
-								/* Lamps 24 - 31 are channel select indicators */
-								if (midichunk[2] == 0) {
-									chan[(int) midichunk[1] - 24]->sel(false);
-								} else {
-									chan[(int) midichunk[1] - 24]->sel(true);
-								}
-							} else if (master) { // anything else is a master
-
-								switch ((unsigned char) midichunk[1]) {
-								case 0x5b:
-									// rewind «⏪
-									transport->rw(midichunk[2]);
-									break;
-								case 0x5c:
-									// fwd »⏩
-									transport->ff(midichunk[2]);
-									break;
-								case 0x5d:
-									transport->stop(midichunk[2]);
-									// stop∎■⬛
-									break;
-								case 0x5e:
-									// play‣▶
-									transport->play(midichunk[2]);
-									break;
-								case 0x5f:
-									// master record enable
-									transport->rec(midichunk[2]);
-									break;
-								case 0x73:
-									transport->solo(midichunk[2]);
-									// solo
-									break;
-								case 0x32:
-									transport->flip(midichunk[2]);
-									// Flip
-									break;
-								case 0x33:
-									// global view
-									transport->view(midichunk[2]);
-									break;
-								case 0x28:
-									// track (Trim)
-									transport->track(midichunk[2]);
-									break;
-								case 0x29:
-									// Send
-									transport->send(midichunk[2]);
-									break;
-								case 0x2a:
-									// Pan
-									transport->pan(midichunk[2]);
-									break;
-								case 0x2b:
-									// Plug-in
-									transport->plug(midichunk[2]);
-									break;
-								case 0x2c:
-									// EQ
-									transport->eq(midichunk[2]);
-									break;
-								case 0x2d:
-									// Instrument
-									transport->inst(midichunk[2]);
-									break;
-								// these next two are really shotime only, but don't hurt anything
-								case 0x72:	// time display is time
-									if(midichunk[2] == 0) tm_bt = ':';
-									break;
-								case 0x71:	// time display is beats and bars
-									if(midichunk[2] == 0) tm_bt = '|';
-									break;
-								default:
-								break;
-							}
-							if (!shotime) {
-								// if time is off we have room for more lamps
-								// some day I might even add them  :)
-								switch ((int) midichunk[1]) {
-								case 0x4a:
-									// read/off
-								case 0x4b:
-									// write
-								case 0x4c:
-									// trim (not trim pot)
-								case 0x4d:
-									// touch
-								case 0x4e:
-									// latch
-								case 0x4f:
-									// group
-								case 0x50:
-									//save
-								case 0x51:
-									// undo
-								case 0x54:
-									// marker
-								case 0x55:
-									// nudge
-								case 0x56:
-									// cycle
-								case 0x57:
-									// drop
-								case 0x58:
-									// replace
-								case 0x59:
-									// click
-								case 0x64:
-									// zoom
-								case 0x65:
-									// scrub
-								default:
-									break;
-								}
-							}
-						}
-							break;
-						case 0xd0:
-							// this is meters (make function)
-							int chm; // meter channel
-							int mval; // meter value
-							// divide into chm and mval
-							mval = midichunk[1] & 0x0f;
-							chm = midichunk[1] >> 4;
-							if (mval == 0x0e) {
-								chan[(int)chm]->peak(true);
-								chan[(int)chm]->level(0x0c);
-							} else if (mval == 0x0f) {
-								chan[(int)chm]->peak(false);
-							} else {
-								chan[(int)chm]->level(mval);
-							}
-							break;
-						case 0xb0:
-							// make function
-							if (master) {
-								// timecode
-								if (midichunk[1] & 0x40) {
-									char data1 = 0x20;
-									if( midichunk[2] < 0x20 ) {
-										data1 = midichunk[2] + 0x40;
-										// cludge because some DAWs send @ instead of space
-										if(data1 == 0x40) data1 = 0x20;
-									} else {
-										data1 = midichunk[2];
-									}
-									switch (midichunk[1]) {
-									case 0x4b:	// left assign char
-										disp2_in[0] = data1;
-										disp2.value(disp2_in);
-										break;
-									case 0x4a:	// left assign char
-										disp2_in[1] = data1;
-										disp2.value(disp2_in);
-										break;
-									// timecode stuff, should maybe not be checked
-									// for if not used, if time turned off, no data sent.
-									case 0x49:	// time digit 10 (msb)
-										time1_in[0] = data1;
-										break;
-									case 0x48:	// time digit 9
-										time1_in[1] = data1;
-										break;
-									case 0x47:	// time digit 8
-										time1_in[2] = data1;
-										break;
-									case 0x46:	// time digit 7
-										time1_in[4] = data1;
-										break;
-									case 0x45:	// time digit 6
-										time1_in[5] = data1;
-										break;
-									case 0x44:	// time digit 5
-										time1_in[7] = data1;
-										break;
-									case 0x43:	// time digit 4
-										time1_in[8] = data1;
-										break;
-									case 0x42:	// time digit 3
-										time1_in[10] = data1;
-										break;
-									case 0x41:	// time digit 2
-										time1_in[11] = data1;
-										break;
-									case 0x40:	// time digit 1 (lsb)
-										time1_in[12] = data1;
-										break;
-									default:
-										break;
-									}
-									if(shotime) {
-									// insert | for beats or : for time.
-									// this is odd, we should only do this when mode switches
-									time1_in[3] = tm_bt;
-									time1_in[6] = tm_bt;
-									time1_in[9] = tm_bt;
-									// diplay time.
-									time1.value(time1_in);
-									}
-								}
-
-							}
-
-						default:
-							break;
-						}
-					}
+		if (dump_trace) {
+			dump_trace = 0;
+			trace_dump();
+		}
+		if (quit_now) {
+			finish();
+			jack_close();
+			exit(0);
+		}
+		if (!jack_seen) {
+			const char* why = jack_error.load();
+			if (why) {
+				std::cout << why << std::endl;
+				fl_alert ("%s", why);
+				return 1;
+			}
+			if (!jack_ready.load()) {
+				// nothing to read yet, keep the window alive
+				continue;
+			}
+			jack_seen = true;
+			// jack may have given us a different name
+			strcpy (wname,"Mackie Control Display Emulator - ");
+			strcat (wname, jack_get_client_name(client));
+			win.copy_label(wname);
+			if (state_guess && strcmp(jackname, jack_get_client_name(client))) {
+				// renamed, as a second extender is. What we showed
+				// is some other instance's, use our own or nothing
+				snapshot_default(state_file, sizeof(state_file), jack_get_client_name(client));
+				if (!snapshot_load(state_file, &surface)) {
+					surface = Surface();
 				}
 			}
+			// clear the placeholder, or redraw what was restored
+			surface.touch_all();
+			startup_step("first frame with jack");
+			startup_report();
+		}
+		{
+		TRACE_SPAN("ring drain");
+		// lamps always all the way, the bulk lanes up to their
+		// budget. Lanes touch different parts of the surface so
+		// reading them out of order still ends in the right state.
+		drain_lane(midibuffer[LANE_LAMP], decoder[LANE_LAMP], 0);
+		drain_lane(midibuffer[LANE_LEVEL], decoder[LANE_LEVEL], LANE_BUDGET);
+		drain_lane(midibuffer[LANE_TEXT], decoder[LANE_TEXT], LANE_BUDGET);
+		}
+		// anything process() wanted to say
+		rtlog.drain(jack_get_time());
+
+		// faders and vpots get their one update for this frame
+		show_surface();
+		if (osc.is_open()) {
+			TRACE_SPAN("osc");
+			osc.send(surface);
 		}
-		} // too lazy to reindent all  :)
 
 		//tell meters to decrement
 		for (int i = 0; i < 8; i++) {
 			chan[i]->decr();
 		}
+		if (meter_hist) {
+			// time moves on even when nothing is playing
+			meter_history.advance(jack_get_time());
+			for (int i = 0; i < 8; i++) {
+				chan[i]->history();
+			}
+		}
+
+#ifdef MCPDISP_TRACE
+		{
+			// draw here rather than inside the wait so the
+			// redraw shows up as a span of its own
+			TRACE_SPAN("flush");
+			Fl::flush();
+		}
+#endif
+		if (measure && latency.pending()) {
+			// draw now rather than at the next wait so we know
+			// when what we just parsed actually went out
+			Fl::flush();
+			latency.flushed(jack_get_time());
+		}
 
 
 	}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include <string.h>
+
+#include "meterhist.h"
+
+MeterHistory::MeterHistory()
+{
+	memset(cols, 0, sizeof(cols));
+	newest = 0;
+	memset(serial, 0, sizeof(serial));
+	for (int ch = 0; ch < 8; ch++) {
+		oldest[ch] = MH_NONE;
+	}
+}
+
+void MeterHistory::advance (uint64_t now)
+{
+	uint64_t col = now / MH_COLUMN_US;
+	if (col <= newest) {
+		return;
+	}
+	// columns we skipped had nothing in them. Never more than all
+	// of them, however long it has been quiet.
+	uint64_t n = col - newest;
+	if (n > MH_COLUMNS) {
+		n = MH_COLUMNS;
+	}
+	for (uint64_t c = col - n + 1; c <= col; c++) {
+		for (int ch = 0; ch < 8; ch++) {
+			cols[ch][c % MH_COLUMNS] = 0;
+		}
+	}
+	newest = col;
+	for (int ch = 0; ch < 8; ch++) {
+		serial[ch]++;
+	}
+}
+
+void MeterHistory::add (int ch, unsigned char val, uint64_t stamp)
+{
+	unsigned char q;
+	if (val == 0x0e) {
+		q = MH_TOP | MH_OVER;
+	} else if (val <= MH_TOP) {
+		q = val;
+	} else {
+		// clear overload, nothing to keep
+		return;
+	}
+	uint64_t col = stamp ? stamp / MH_COLUMN_US : newest;
+	advance(col * MH_COLUMN_US);
+	if (col + MH_COLUMNS <= newest) {
+		return;
+	}
+	// keep the loudest, and any overload sticks for the column
+	unsigned char& cell = cols[ch & 7][col % MH_COLUMNS];
+	unsigned char lv = cell & ~MH_OVER;
+	if ((q & ~MH_OVER) > lv) {
+		lv = q & ~MH_OVER;
+	}
+	lv |= (cell | q) & MH_OVER;
+	if (lv != cell) {
+		cell = lv;
+		serial[ch & 7]++;
+		if (col < oldest[ch & 7]) {
+			oldest[ch & 7] = col;
+		}
+	}
+}
+
+uint64_t MeterHistory::take_oldest (int ch)
+{
+	uint64_t col = oldest[ch & 7];
+	oldest[ch & 7] = MH_NONE;
+	return col;
+}
+
+unsigned char MeterHistory::column (int ch, uint64_t col) const
+{
+	if (col > newest || col + MH_COLUMNS <= newest) {
+		return 0;
+	}
+	return cols[ch & 7][col % MH_COLUMNS];
+}
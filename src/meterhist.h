@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_METERHIST_H
+#define MCPDISP_METERHIST_H
+
+#include <stdint.h>
+
+// each column of history is this long, so the strip shows
+// MH_COLUMN_US * columns of time whatever the frame rate
+#define MH_COLUMN_US	100000
+// columns kept per channel, more than any strip is wide
+#define MH_COLUMNS	256
+// the loudest a column can be, meter steps 0 - 12
+#define MH_TOP		12
+// set in a column that saw an overload
+#define MH_OVER		0x80
+// no column, from take_oldest
+#define MH_NONE		(~(uint64_t) 0)
+
+// MeterHistory is the last MH_COLUMNS columns of meter level for each
+// strip. A column is the loudest meter value stamped inside its
+// MH_COLUMN_US of the jack clock. Everything is fixed arrays so it
+// costs the same after an hour as after a second.
+class MeterHistory
+{
+public:
+	MeterHistory();
+
+	// a meter value as sent (0 - 12, 14 overload) stamped in jack
+	// microseconds. 0 means now.
+	void add (int ch, unsigned char val, uint64_t stamp);
+	// move time along to now even if nothing is coming in
+	void advance (uint64_t now);
+	// the newest column, counting from the start of the jack clock
+	uint64_t head (void) const { return newest; }
+	// column col of channel ch, 0 if it is too old to remember
+	unsigned char column (int ch, uint64_t col) const;
+	// goes up every time anything on channel ch changes
+	uint32_t changes (int ch) const { return serial[ch & 7]; }
+	// the oldest column of ch that add() changed since the last
+	// call, MH_NONE if none. Late meter values can land in columns
+	// older than the newest.
+	uint64_t take_oldest (int ch);
+
+private:
+	unsigned char cols[8][MH_COLUMNS];
+	uint64_t newest;
+	uint32_t serial[8];
+	uint64_t oldest[8];
+};
+
+#endif
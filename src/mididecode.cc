@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include "mididecode.h"
+
+MidiDecoder::MidiDecoder(msg_cb cb, void* arg) :
+	callback(cb),
+	cb_arg(arg),
+	now(0)
+{
+	// display dumps are small, this means we never grow for mcp
+	sysex.reserve(256);
+	reset();
+}
+
+void MidiDecoder::reset (void)
+{
+	running = 0;
+	have = 0;
+	need = 0;
+	in_sysex = false;
+	sysex.clear();
+}
+
+void MidiDecoder::feed (const unsigned char* bytes, size_t len, uint64_t stamp)
+{
+	now = stamp;
+	for (size_t i = 0; i < len; i++) {
+		unsigned char b = bytes[i];
+		if (b >= 0xf8) {
+			// real time can show up anywhere, even inside sysex
+			// it does not touch running status
+			callback(&bytes[i], 1, now, cb_arg);
+		} else if (b & 0x80) {
+			status(b);
+		} else {
+			data(b);
+		}
+	}
+}
+
+void MidiDecoder::status (unsigned char b)
+{
+	if (b == 0xf7) {
+		if (in_sysex) {
+			sysex.push_back(b);
+			callback(sysex.data(), sysex.size(), now, cb_arg);
+			in_sysex = false;
+			sysex.clear();
+		}
+		return;
+	}
+	// any other status ends a sysex that never got its f7, drop it
+	in_sysex = false;
+	sysex.clear();
+	have = 0;
+
+	if (b == 0xf0) {
+		running = 0;
+		in_sysex = true;
+		sysex.push_back(b);
+		return;
+	}
+
+	msg[0] = b;
+	have = 1;
+	if (b < 0xf0) {
+		running = b;
+		// program change and channel pressure have one data byte
+		need = ((b & 0xf0) == 0xc0 || (b & 0xf0) == 0xd0) ? 2 : 3;
+		return;
+	}
+	// system common cancels running status
+	running = 0;
+	switch (b) {
+	case 0xf1:	// quarter frame
+	case 0xf3:	// song select
+		need = 2;
+		break;
+	case 0xf2:	// song position
+		need = 3;
+		break;
+	default:	// tune request and the undefined ones
+		callback(msg, 1, now, cb_arg);
+		have = 0;
+		break;
+	}
+}
+
+void MidiDecoder::data (unsigned char b)
+{
+	if (in_sysex) {
+		if (sysex.size() < MAX_SYSEX) {
+			sysex.push_back(b);
+		} else {
+			// runaway sysex, throw it away and wait for the next status
+			in_sysex = false;
+			sysex.clear();
+		}
+		return;
+	}
+	if (!have) {
+		if (!running) {
+			// stray data byte with nothing to belong to
+			return;
+		}
+		msg[0] = running;
+		have = 1;
+		need = ((running & 0xf0) == 0xc0 || (running & 0xf0) == 0xd0) ? 2 : 3;
+	}
+	msg[have++] = b;
+	if (have == need) {
+		callback(msg, have, now, cb_arg);
+		have = 0;
+	}
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_MIDIDECODE_H
+#define MCPDISP_MIDIDECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// largest sysex we will put together before giving up on it.
+// mcp display dumps are about 120 bytes so this is very generous
+#define MAX_SYSEX 65536
+
+// MidiDecoder takes raw midi bytes in whatever chunks they arrive
+// and hands back whole messages. It does not care where jack event
+// boundaries are so running status and sysex split over many
+// events (or many periods) come out the same as if sent in one piece.
+// Each message comes out with the time stamp of the chunk that
+// finished it.
+class MidiDecoder
+{
+public:
+	typedef void (*msg_cb)(const unsigned char* msg, size_t len, uint64_t stamp, void* arg);
+
+	MidiDecoder(msg_cb cb, void* arg = 0);
+
+	// feed some bytes, callback is called for each finished message
+	void feed(const unsigned char* data, size_t len, uint64_t stamp = 0);
+	// forget any partial message and running status
+	void reset(void);
+
+private:
+	msg_cb callback;
+	void* cb_arg;
+	uint64_t now;		// stamp of the bytes being fed
+	unsigned char running;	// running status, 0 if none
+	unsigned char msg[3];	// channel or system common message being built
+	int have;		// bytes in msg so far
+	int need;		// bytes msg needs to be complete
+	bool in_sysex;
+	std::vector<unsigned char> sysex;
+
+	void status (unsigned char b);
+	void data (unsigned char b);
+};
+
+#endif
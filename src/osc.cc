@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "osc.h"
+
+OscOut::OscOut() :
+	sock(-1),
+	addrlen(0),
+	first(true),
+	len(0),
+	msgs(0)
+{
+}
+
+OscOut::~OscOut()
+{
+	if (sock >= 0) {
+		close(sock);
+	}
+}
+
+bool OscOut::open (const char* where)
+{
+	char host[256];
+	const char* port = strrchr(where, ':');
+	if (port) {
+		size_t n = port - where;
+		if (n >= sizeof(host)) {
+			return false;
+		}
+		memcpy(host, where, n);
+		host[n] = 0x00;
+		port++;
+	} else {
+		strcpy(host, "127.0.0.1");
+		port = where;
+	}
+
+	struct addrinfo hints;
+	struct addrinfo* res;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, port, &hints, &res)) {
+		return false;
+	}
+	sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (sock >= 0) {
+		// never wait on the network, a lost frame is fine
+		fcntl(sock, F_SETFL, O_NONBLOCK);
+		memcpy(&addr, res->ai_addr, res->ai_addrlen);
+		addrlen = res->ai_addrlen;
+		// allow sending to a broadcast address too
+		int on = 1;
+		setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+	}
+	freeaddrinfo(res);
+	return sock >= 0;
+}
+
+void OscOut::begin (void)
+{
+	len = 0;
+	msgs = 0;
+	put_str("#bundle", 7);
+	// time tag 1 means right away
+	put_int(0);
+	put_int(1);
+}
+
+void OscOut::flush (void)
+{
+	if (msgs) {
+		sendto(sock, buf, len, 0, (struct sockaddr*) &addr, addrlen);
+	}
+	begin();
+}
+
+bool OscOut::room (size_t need)
+{
+	if (len + need > OSC_MAX) {
+		// this one starts a new bundle
+		flush();
+	}
+	return len + need <= OSC_MAX;
+}
+
+// osc string: the chars, a nul and padding to 4 bytes
+void OscOut::put_str (const char* s, size_t n)
+{
+	memcpy(&buf[len], s, n);
+	len += n;
+	do {
+		buf[len++] = 0x00;
+	} while (len & 3);
+}
+
+// osc int32, big endian
+void OscOut::put_int (int v)
+{
+	unsigned int u = (unsigned int) v;
+	buf[len++] = (u >> 24) & 0xff;
+	buf[len++] = (u >> 16) & 0xff;
+	buf[len++] = (u >> 8) & 0xff;
+	buf[len++] = u & 0xff;
+}
+
+void OscOut::add_int (const char* path, int v)
+{
+	size_t plen = strlen(path);
+	// size, path, ",i" and the int
+	if (!room(4 + plen + 4 + 4 + 4)) {
+		return;
+	}
+	size_t start = len;
+	put_int(0);
+	put_str(path, plen);
+	put_str(",i", 2);
+	put_int(v);
+	// now we know the element size
+	size_t el = len - start - 4;
+	len = start;
+	put_int((int) el);
+	len = start + 4 + el;
+	msgs++;
+}
+
+void OscOut::add_str (const char* path, const char* s, size_t n)
+{
+	size_t plen = strlen(path);
+	if (!room(4 + plen + 4 + 4 + n + 4)) {
+		return;
+	}
+	size_t start = len;
+	put_int(0);
+	put_str(path, plen);
+	put_str(",s", 2);
+	put_str(s, n);
+	size_t el = len - start - 4;
+	len = start;
+	put_int((int) el);
+	len = start + 4 + el;
+	msgs++;
+}
+
+void OscOut::send (const Surface& surf)
+{
+	if (sock < 0) {
+		return;
+	}
+	if (!first && surf.generation == last.generation
+			&& !memcmp(surf.meter, last.meter, sizeof(surf.meter))) {
+		// nothing new, don't even look
+		return;
+	}
+	char path[64];
+	begin();
+	for (int x = 0; x < 8; x++) {
+		int st = x * 7;
+		if (first || memcmp(&surf.line1[st], &last.line1[st], 7)) {
+			snprintf(path, sizeof(path), "/mcpdisp/strip/%d/top", x + 1);
+			add_str(path, &surf.line1[st], 7);
+		}
+		if (first || memcmp(&surf.line2[st], &last.line2[st], 7)) {
+			snprintf(path, sizeof(path), "/mcpdisp/strip/%d/bottom", x + 1);
+			add_str(path, &surf.line2[st], 7);
+		}
+		if (first || surf.meter[x] != last.meter[x]) {
+			snprintf(path, sizeof(path), "/mcpdisp/strip/%d/meter", x + 1);
+			add_int(path, surf.meter[x]);
+		}
+		if (first || surf.fader[x] != last.fader[x]) {
+			snprintf(path, sizeof(path), "/mcpdisp/strip/%d/fader", x + 1);
+			add_int(path, surf.fader[x]);
+		}
+		if (first || surf.vpot[x] != last.vpot[x]) {
+			snprintf(path, sizeof(path), "/mcpdisp/strip/%d/vpot", x + 1);
+			add_int(path, surf.vpot[x]);
+		}
+	}
+	if (first || surf.fader[8] != last.fader[8]) {
+		add_int("/mcpdisp/master/fader", surf.fader[8]);
+	}
+	for (int w = 0; w < 2; w++) {
+		uint64_t diff = first ? ~(uint64_t) 0 : surf.lamp[w] ^ last.lamp[w];
+		while (diff) {
+			int n = w * 64 + __builtin_ctzll(diff);
+			diff &= diff - 1;
+			snprintf(path, sizeof(path), "/mcpdisp/lamp/%d", n);
+			add_int(path, surf.lamp_on(n));
+		}
+	}
+	if (first || memcmp(surf.assign, last.assign, 2)) {
+		add_str("/mcpdisp/assign", surf.assign, 2);
+	}
+	if (first || memcmp(surf.timecode, last.timecode, 13) || surf.tm_bt != last.tm_bt) {
+		char text[13];
+		memcpy(text, surf.timecode, 13);
+		text[3] = surf.tm_bt;
+		text[6] = surf.tm_bt;
+		text[9] = surf.tm_bt;
+		add_str("/mcpdisp/timecode", text, 13);
+	}
+	flush();
+	last = surf;
+	first = false;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_OSC_H
+#define MCPDISP_OSC_H
+
+#include <stddef.h>
+#include <sys/socket.h>
+
+#include "surface.h"
+
+// biggest datagram we build, a full dump of everything is about 6k
+#define OSC_MAX 16384
+
+// OscOut sends the surface to some other display as OSC over UDP.
+// Once a frame it compares the surface with what it sent last time
+// and puts every field that changed into one bundle, so a listener
+// gets one datagram a frame at most. Addresses are:
+//	/mcpdisp/strip/<1-8>/top s	/mcpdisp/strip/<1-8>/bottom s
+//	/mcpdisp/strip/<1-8>/meter i	/mcpdisp/strip/<1-8>/fader i
+//	/mcpdisp/strip/<1-8>/vpot i	/mcpdisp/master/fader i
+//	/mcpdisp/lamp/<note> i		/mcpdisp/assign s
+//	/mcpdisp/timecode s
+// Meter, fader and vpot values are as the daw sent them.
+class OscOut
+{
+public:
+	OscOut();
+	~OscOut();
+
+	// where to send: "port" or "host:port", false if no good
+	bool open (const char* where);
+	bool is_open (void) const { return sock >= 0; }
+	// send whatever changed since last time
+	void send (const Surface& surf);
+
+private:
+	int sock;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	// what the listener has been told
+	Surface last;
+	bool first;
+	char buf[OSC_MAX];
+	size_t len;
+	int msgs;
+
+	void begin (void);
+	void flush (void);
+	bool room (size_t need);
+	void put_str (const char* s, size_t n);
+	void put_int (int v);
+	void add_int (const char* path, int v);
+	void add_str (const char* path, const char* s, size_t n);
+};
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+// rtbench times RtCore, the part of process() that does the work,
+// without a jack server. It hands it periods of midi made up ahead
+// of time, the way jack would, and counts how long each period takes.
+// The lanes are emptied between periods, outside the timing, as the
+// gui would. Run it with "meson test --benchmark" or by hand, with
+// an optional number of periods per test.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "rtcore.h"
+
+#define RATE 48000
+
+// cpu cycles where we can read them, nanoseconds anywhere else
+#if defined(__x86_64__) || defined(__i386__)
+static const char* unit = "cycles";
+static inline uint64_t ticks (void)
+{
+	return __rdtsc();
+}
+#else
+static const char* unit = "ns";
+static inline uint64_t ticks (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+// one period of midi as jack would give it to process()
+struct Period {
+	std::vector<std::vector<unsigned char> > msgs;
+	std::vector<jack_midi_event_t> ev;
+
+	void add (jack_nframes_t time, const unsigned char* m, size_t len) {
+		msgs.push_back(std::vector<unsigned char>(m, m + len));
+		jack_midi_event_t e;
+		e.time = time;
+		e.size = len;
+		e.buffer = 0;
+		ev.push_back(e);
+	}
+	// only once all msgs are in, they move while growing
+	void fix (void) {
+		for (size_t i = 0; i < ev.size(); i++) {
+			ev[i].buffer = &msgs[i][0];
+		}
+	}
+};
+
+// RtCore's other end: events come from a Period, thru and to daw
+// copies go into a flat buffer like a jack port buffer
+struct BenchIo {
+	const Period* p;
+	jack_nframes_t cycle;
+	unsigned char out[8192];
+	size_t used;
+
+	RT_INLINE uint32_t count (void) {
+		return p->ev.size();
+	}
+	RT_INLINE void get (jack_midi_event_t* ev, uint32_t i) {
+		*ev = p->ev[i];
+	}
+	RT_INLINE unsigned char* thru (size_t size) {
+		if (used + size > sizeof(out)) {
+			return 0;
+		}
+		unsigned char* b = out + used;
+		used += size;
+		return b;
+	}
+	RT_INLINE bool daw (void) {
+		return true;
+	}
+	RT_INLINE void to_daw (const unsigned char* msg, size_t len) {
+		if (used + len <= sizeof(out)) {
+			memcpy(out + used, msg, len);
+			used += len;
+		}
+	}
+	RT_INLINE jack_time_t stamp (jack_nframes_t time) {
+		return (jack_time_t) (cycle + time) * 1000000 / RATE;
+	}
+};
+
+// true if something that happens every us microseconds happens in
+// the period starting at frame f
+static bool every (uint64_t f, jack_nframes_t nframes, uint64_t us)
+{
+	uint64_t step = us * RATE / 1000000;
+	return (f + nframes) / step != f / step;
+}
+
+// A daw playing back: meters on every strip, one fader under
+// automation, the clock running, now and then a name or a lamp.
+static void realistic (std::vector<Period>& load, int periods, jack_nframes_t nframes)
+{
+	load.resize(periods);
+	for (int n = 0; n < periods; n++) {
+		Period& p = load[n];
+		uint64_t f = (uint64_t) n * nframes;
+		if (every(f, nframes, 30000)) {
+			for (int ch = 0; ch < 8; ch++) {
+				unsigned char m[2] = { 0xd0, (unsigned char) ((ch << 4) | (n % 13)) };
+				p.add(ch % nframes, m, 2);
+			}
+		}
+		if (every(f, nframes, 10000)) {
+			unsigned char m[3] = { 0xe2, (unsigned char) (n & 0x7f), (unsigned char) ((n >> 7) & 0x7f) };
+			p.add(0, m, 3);
+		}
+		if (every(f, nframes, 33000)) {
+			unsigned char m[3] = { 0xb0, 0x40, (unsigned char) (0x30 + n % 10) };
+			p.add(1, m, 3);
+			m[1] = 0x41;
+			p.add(1, m, 3);
+		}
+		if (every(f, nframes, 250000)) {
+			unsigned char m[3] = { 0x90, (unsigned char) (0x5b + n % 5), 0x7f };
+			p.add(2, m, 3);
+		}
+		if (every(f, nframes, 500000)) {
+			unsigned char m[15] = { 0xf0, 0x00, 0x00, 0x66, 0x14, 0x12,
+				(unsigned char) (7 * (n % 8)), 'A', 'u', 'd', 'i', 'o', ' ', '1', 0xf7 };
+			p.add(3 % nframes, m, 15);
+		}
+		p.fix();
+	}
+}
+
+// A bank change every period: the whole display, every strip lamp,
+// vpot, fader and meter at once.
+static void burst (std::vector<Period>& load, int periods)
+{
+	load.resize(periods);
+	for (int n = 0; n < periods; n++) {
+		Period& p = load[n];
+		unsigned char d[120] = { 0xf0, 0x00, 0x00, 0x66, 0x14, 0x12, 0x00 };
+		for (int i = 0; i < 112; i++) {
+			d[7 + i] = 'a' + (n + i) % 26;
+		}
+		d[119] = 0xf7;
+		p.add(0, d, 120);
+		for (int i = 0; i < 32; i++) {
+			unsigned char m[3] = { 0x90, (unsigned char) i, (unsigned char) ((n + i) & 1 ? 0x7f : 0x00) };
+			p.add(1, m, 3);
+		}
+		for (int ch = 0; ch < 8; ch++) {
+			unsigned char v[3] = { 0xb0, (unsigned char) (0x30 + ch), (unsigned char) (n & 0x3f) };
+			p.add(2, v, 3);
+		}
+		for (int ch = 0; ch < 9; ch++) {
+			unsigned char m[3] = { (unsigned char) (0xe0 + ch), (unsigned char) (n & 0x7f), 0x40 };
+			p.add(3, m, 3);
+		}
+		for (int ch = 0; ch < 8; ch++) {
+			unsigned char m[2] = { 0xd0, (unsigned char) ((ch << 4) | 0x0c) };
+			p.add(4, m, 2);
+		}
+		p.fix();
+	}
+}
+
+static void run (const char* name, const std::vector<Period>& load, jack_nframes_t nframes)
+{
+	RtCore<BenchIo> core;
+	for (int l = 0; l < LANES; l++) {
+		core.lane[l] = jack_ringbuffer_create(lane_size[l]);
+	}
+	core.master = true;
+	BenchIo io;
+	std::vector<uint64_t> took(load.size());
+	uint64_t events = 0;
+	uint64_t total = 0;
+	// first pass warms caches and is thrown away
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t n = 0; n < load.size(); n++) {
+			io.p = &load[n];
+			io.cycle = n * nframes;
+			io.used = 0;
+			uint64_t t0 = ticks();
+			core.period(io);
+			uint64_t t1 = ticks();
+			took[n] = t1 - t0;
+			for (int l = 0; l < LANES; l++) {
+				jack_ringbuffer_read_advance(core.lane[l], jack_ringbuffer_read_space(core.lane[l]));
+			}
+		}
+	}
+	for (size_t n = 0; n < load.size(); n++) {
+		events += load[n].ev.size();
+		total += took[n];
+	}
+	std::sort(took.begin(), took.end());
+	printf("%-10s %3u frames %6.2f events/period  %s/period: median %6llu p99 %6llu max %7llu  %s/event: %6.1f\n",
+		name, nframes, (double) events / load.size(), unit,
+		(unsigned long long) took[took.size() / 2],
+		(unsigned long long) took[took.size() * 99 / 100],
+		(unsigned long long) took.back(),
+		unit, events ? (double) total / events : 0.0);
+	for (int l = 0; l < LANES; l++) {
+		jack_ringbuffer_free(core.lane[l]);
+	}
+}
+
+int main (int argc, char** argv)
+{
+	int periods = 20000;
+	if (argc > 1) {
+		periods = atoi(argv[1]);
+		if (periods < 100) {
+			fprintf(stderr, "usage: rtbench [periods, at least 100]\n");
+			return 1;
+		}
+	}
+	static const jack_nframes_t sizes[] = { 32, 64 };
+	for (int s = 0; s < 2; s++) {
+		std::vector<Period> load;
+		realistic(load, periods, sizes[s]);
+		run("realistic", load, sizes[s]);
+		load.clear();
+		burst(load, periods);
+		run("burst", load, sizes[s]);
+	}
+	return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_RTCORE_H
+#define MCPDISP_RTCORE_H
+
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include <jack/ringbuffer.h>
+
+#include "rtlog.h"
+
+// Io members, see RtCore
+#define RT_INLINE inline __attribute__((always_inline))
+
+// need ring buffers to go from real time to not. Events are sorted
+// into lanes so a flood of display text or meters can never hold up
+// the lamps. Lanes are read in this order, lamps first.
+enum {
+	LANE_LAMP = 0,	// note on: transport, strip and master lamps
+	LANE_LEVEL,	// meters, faders, vpots and other cc
+	LANE_TEXT,	// sysex: scribble strip and anything else
+	LANES
+};
+static const size_t lane_size[LANES] = { 4096, 16384, 16384 };
+
+enum {
+	PROTO_MCP = 0,
+	PROTO_HUI
+};
+
+// each ring buffer record is one of these followed by size bytes
+// of midi: one whole channel message with its status byte, a lone
+// real time byte, or a piece of sysex that the decoder puts back
+// together.
+struct MidiRec {
+	unsigned int size;
+	jack_time_t stamp;	// when the event hit the port
+};
+
+// What we tell the daw our serial number is, and the challenge
+// it is supposed to answer. We don't check the answer.
+static const unsigned char mcp_serial[7] = { 'M', 'C', 'P', 'D', 'I', 'S', 'P' };
+static const unsigned char mcp_challenge[4] = { 'm', 'c', 'p', 'd' };
+
+// RtCore is everything process() does once it has its port buffers:
+// sort events into lanes, copy them to thru and answer the daw. It
+// gets midi in and out through Io so it can be run without jack,
+// which is how rtbench times it. Io needs:
+//	uint32_t count ()			events this period
+//	void get (jack_midi_event_t* ev, uint32_t i)
+//	unsigned char* thru (size_t size)	room for a thru copy, or 0
+//	bool daw ()				is there a _to_daw port
+//	void to_daw (const unsigned char* msg, size_t len)
+//	jack_time_t stamp (jack_nframes_t time)	time of an event
+// mcpdisp is built with -O0, which inlines nothing on its own, so Io
+// members should be marked RT_INLINE. Then going through Io costs no
+// more than calling jack directly.
+template <class Io>
+class RtCore
+{
+public:
+	jack_ringbuffer_t *lane[LANES];
+	int protocol;
+	bool master;
+	// set when the daw should be asked to send everything again
+	std::atomic<bool> *resync;
+	RtLog *log;
+
+	RtCore() {
+		memset(lane, 0, sizeof(lane));
+		protocol = PROTO_MCP;
+		master = false;
+		resync = 0;
+		log = 0;
+		running = 0;
+		in_sysex = false;
+		sysex_gap = false;
+		have = 0;
+		need = 0;
+	}
+
+	// one period worth of midi
+	void period (Io& io) {
+		unsigned char dev_id = master ? 0x14 : 0x15;
+		if (io.daw() && resync && resync->exchange(false) && protocol == PROTO_MCP) {
+			handshake(io, dev_id, 0x01);
+		}
+		jack_midi_event_t in_event;
+		uint32_t event_count = io.count();
+		for (uint32_t i = 0; i < event_count; i++) {
+			io.get(&in_event, i);
+			event(io, in_event, dev_id);
+		}
+	}
+
+private:
+	// where the midi stream is, carried from one event to the next
+	unsigned char running;
+	bool in_sysex;
+	// part of the open sysex never made it to the lane, the rest of
+	// it is thrown away too so the decoder never joins the pieces
+	// either side of the hole
+	bool sysex_gap;
+	// channel or system common message being put together, it may
+	// have started in an earlier event
+	unsigned char msg[3];
+	int have;
+	int need;
+
+	void event (Io& io, jack_midi_event_t& in_event, unsigned char dev_id) {
+		// send event to through here
+		unsigned char* buffer = io.thru(in_event.size);
+		if (buffer) {
+			memcpy (buffer, in_event.buffer, in_event.size);
+		} else if (in_event.size) {
+			post(RTLOG_RESERVE, RTLOG_NO_LANE, in_event.size);
+		}
+
+		split(io, in_event.buffer, in_event.size, io.stamp(in_event.time));
+
+		unsigned char* ev = in_event.buffer;
+		// answer the daw's half of the mcp handshake
+		if (io.daw() && protocol == PROTO_MCP && in_event.size >= 7 && ev[0] == 0xf0 && ev[1] == 0x00
+				&& ev[2] == 0x00 && ev[3] == 0x66 && ev[4] == dev_id) {
+			if (ev[5] == 0x00) {
+				// device query, tell it who we are
+				handshake(io, dev_id, 0x01);
+			} else if (ev[5] == 0x02) {
+				// host connection reply, confirm it
+				handshake(io, dev_id, 0x03);
+			}
+		}
+	}
+
+	void post (int code, int l, uint32_t size) {
+		if (log) {
+			log->post(code, l, size);
+		}
+	}
+
+	// Play the surface side of the mcp handshake. Device id is 0x14
+	// for a main unit and 0x15 for an extender. Sending a host connection
+	// query (0x01) when the daw did not ask is what makes most daws
+	// treat us as newly connected and send the whole display again.
+	void handshake (Io& io, unsigned char id, unsigned char type) {
+		unsigned char msg[18] = { 0xf0, 0x00, 0x00, 0x66, id, type };
+		size_t len = 6;
+		memcpy (&msg[len], mcp_serial, 7);
+		len += 7;
+		if (type == 0x01) {
+			memcpy (&msg[len], mcp_challenge, 4);
+			len += 4;
+		}
+		msg[len++] = 0xf7;
+		io.to_daw(msg, len);
+	}
+
+	// Cut an event into messages and put each in the lane for its
+	// kind. A jack event can hold more than one message, or part of
+	// one, or data bytes that lean on running status from an earlier
+	// event. Channel messages are written out whole with their status
+	// byte so each lane decoder has all it needs whatever went to the
+	// other lanes. Sysex is not held back, each piece of it goes to
+	// the text lane as it comes and the decoder puts it together.
+	void split (Io& io, const unsigned char* ev, size_t len, jack_time_t stamp) {
+		size_t sx = 0;	// where sysex bytes start in this event
+		for (size_t i = 0; i < len; i++) {
+			unsigned char b = ev[i];
+			if (in_sysex) {
+				if (b < 0x80 || b >= 0xf8) {
+					// real time inside sysex stays with it
+					continue;
+				}
+				// f7, or any other status, ends it
+				sysex_piece(ev + sx, (b == 0xf7 ? i + 1 : i) - sx, stamp);
+				in_sysex = false;
+				if (b == 0xf7) {
+					continue;
+				}
+			}
+			if (b >= 0xf8) {
+				// real time alone, belongs to nobody
+				put(LANE_LEVEL, ev + i, 1, stamp);
+			} else if (b == 0xf0) {
+				running = 0;
+				have = 0;
+				in_sysex = true;
+				sysex_gap = false;
+				sx = i;
+			} else if (b == 0xf7) {
+				// stray end of sysex
+				have = 0;
+			} else if (b & 0x80) {
+				msg[0] = b;
+				have = 1;
+				if (b < 0xf0) {
+					running = b;
+					// program change and channel pressure have one data byte
+					need = ((b & 0xf0) == 0xc0 || (b & 0xf0) == 0xd0) ? 2 : 3;
+				} else {
+					// system common cancels running status
+					running = 0;
+					need = (b == 0xf1 || b == 0xf3) ? 2 : (b == 0xf2 ? 3 : 1);
+				}
+				if (have == need) {
+					message(io, stamp);
+				}
+			} else {
+				if (!have) {
+					if (!running) {
+						// stray data byte with nothing to belong to
+						continue;
+					}
+					msg[0] = running;
+					have = 1;
+					need = ((running & 0xf0) == 0xc0 || (running & 0xf0) == 0xd0) ? 2 : 3;
+				}
+				msg[have++] = b;
+				if (have == need) {
+					message(io, stamp);
+				}
+			}
+		}
+		if (in_sysex && len > sx) {
+			sysex_piece(ev + sx, len - sx, stamp);
+		}
+	}
+
+	// Without its f7 the text lane decoder holds what it has of a
+	// sysex until the next status and then drops it, which is what
+	// we want once a piece has gone missing.
+	void sysex_piece (const unsigned char* data, size_t len, jack_time_t stamp) {
+		if (sysex_gap) {
+			return;
+		}
+		if (!put(LANE_TEXT, data, len, stamp)) {
+			sysex_gap = true;
+		}
+	}
+
+	// a whole message in msg, lamps get their own lane
+	void message (Io& io, jack_time_t stamp) {
+		unsigned char status = msg[0];
+		int l = LANE_LEVEL;
+		if ((status & 0xf0) == 0x90) {
+			l = LANE_LAMP;
+			if (protocol == PROTO_HUI && io.daw() && status == 0x90
+					&& msg[1] == 0x00 && msg[2] == 0x00) {
+				// HUI ping, the daw drops us if it goes unanswered.
+				// Pings after the first often lean on running status.
+				static const unsigned char pong[3] = { 0x90, 0x00, 0x7f };
+				io.to_daw(pong, 3);
+			}
+		} else if (protocol == PROTO_HUI && status == 0xb0
+				&& (msg[1] == 0x0c || msg[1] == 0x2c)) {
+			// HUI lamps are zone/port cc pairs. Both halves of a
+			// pair land here whether they came with their b0 or
+			// with running status, so the zone is always the one
+			// the port goes with.
+			l = LANE_LAMP;
+		}
+		put(l, msg, have, stamp);
+		have = 0;
+	}
+
+	// header and data must both fit or we skip the whole record
+	// the reader waits until it sees both so order is enough
+	// false if any of it did not make it
+	bool put (int l, const unsigned char* data, size_t len, jack_time_t stamp) {
+		if (!len) {
+			return true;
+		}
+		jack_ringbuffer_t *ring = lane[l];
+		if (len + sizeof(MidiRec) >= lane_size[l]) {
+			// would never fit, however empty the lane
+			post(RTLOG_OVERSIZE, l, len);
+			return false;
+		} else if (jack_ringbuffer_write_space(ring) >= sizeof(MidiRec) + len) {
+			MidiRec rec;
+			rec.size = len;
+			rec.stamp = stamp;
+			jack_ringbuffer_write(ring, (const char*) &rec, sizeof(MidiRec));
+			size_t written = jack_ringbuffer_write(ring, (const char*) data, len);
+			if (written != len) {
+				post(RTLOG_PARTIAL, l, len);
+				return false;
+			}
+		} else {
+			post(RTLOG_DROP, l, len);
+			return false;
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "rtlog.h"
+
+static const char* lane_name[] = { "lamp", "level", "text" };
+
+static const char* code_name[RTLOG_CODES] = {
+	"dropped",
+	"partial writes",
+	"oversize events",
+	"thru reserve failures",
+};
+
+RtLog::RtLog() : lost(0)
+{
+	ring = 0;
+	sys = false;
+	memset(window, 0, sizeof(window));
+	memset(shown, 0, sizeof(shown));
+	memset(held, 0, sizeof(held));
+}
+
+RtLog::~RtLog()
+{
+	if (ring) {
+		jack_ringbuffer_free(ring);
+	}
+	if (sys) {
+		closelog();
+	}
+}
+
+bool RtLog::open (size_t records)
+{
+	ring = jack_ringbuffer_create(records * sizeof(RtLogRec));
+	if (!ring) {
+		return false;
+	}
+	// posted to from process(), so it must not page fault either
+	if (jack_ringbuffer_mlock(ring)) {
+		jack_ringbuffer_free(ring);
+		ring = 0;
+		return false;
+	}
+	return true;
+}
+
+void RtLog::use_syslog (void)
+{
+	openlog("mcpdisp", LOG_PID, LOG_USER);
+	sys = true;
+}
+
+void RtLog::post (int code, int lane, uint32_t size)
+{
+	if (!ring) {
+		return;
+	}
+	if (jack_ringbuffer_write_space(ring) < sizeof(RtLogRec)) {
+		lost++;
+		return;
+	}
+	RtLogRec rec;
+	rec.code = code;
+	rec.lane = lane;
+	rec.spare = 0;
+	rec.size = size;
+	jack_ringbuffer_write(ring, (const char*) &rec, sizeof(RtLogRec));
+}
+
+void RtLog::say (const char* fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	if (sys) {
+		vsyslog(LOG_WARNING, fmt, ap);
+	} else {
+		fprintf(stderr, "mcpdisp: ");
+		vfprintf(stderr, fmt, ap);
+		fprintf(stderr, "\n");
+	}
+	va_end(ap);
+}
+
+void RtLog::tell (const RtLogRec& rec)
+{
+	const char* lane = rec.lane < 3 ? lane_name[rec.lane] : "?";
+	switch (rec.code) {
+	case RTLOG_DROP:
+		say("%s lane full, dropped a %u byte event", lane, rec.size);
+		break;
+	case RTLOG_PARTIAL:
+		say("%s lane took only part of a %u byte event", lane, rec.size);
+		break;
+	case RTLOG_OVERSIZE:
+		say("%u byte event is too big for the %s lane", rec.size, lane);
+		break;
+	case RTLOG_RESERVE:
+		say("no room on the thru port for a %u byte event", rec.size);
+		break;
+	default:
+		break;
+	}
+}
+
+void RtLog::drain (uint64_t now)
+{
+	if (!ring) {
+		return;
+	}
+	uint64_t sec = now / 1000000;
+	// a new second, own up to what was held back in the last one
+	for (int c = 0; c < RTLOG_CODES; c++) {
+		if (window[c] != sec) {
+			if (held[c]) {
+				say("%u more %s in the last second", held[c], code_name[c]);
+			}
+			window[c] = sec;
+			shown[c] = 0;
+			held[c] = 0;
+		}
+	}
+	RtLogRec rec;
+	while (jack_ringbuffer_read_space(ring) >= sizeof(RtLogRec)) {
+		jack_ringbuffer_read(ring, (char*) &rec, sizeof(RtLogRec));
+		if (rec.code >= RTLOG_CODES) {
+			continue;
+		}
+		if (shown[rec.code] < RTLOG_PER_SEC) {
+			shown[rec.code]++;
+			tell(rec);
+		} else {
+			held[rec.code]++;
+		}
+	}
+	uint32_t gone = lost.exchange(0);
+	if (gone) {
+		say("log full, %u messages lost", gone);
+	}
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_RTLOG_H
+#define MCPDISP_RTLOG_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include <jack/ringbuffer.h>
+
+// what went wrong in process()
+enum RtLogCode {
+	RTLOG_DROP = 0,		// lane full, event skipped
+	RTLOG_PARTIAL,		// lane took only part of an event
+	RTLOG_OVERSIZE,		// event bigger than the lane could ever hold
+	RTLOG_RESERVE,		// no room in the thru port for an event
+	RTLOG_CODES
+};
+
+// lane for records that are not about a lane
+#define RTLOG_NO_LANE	0xff
+
+// no more than this many lines a second of any one code, the rest
+// are counted and told about once the second is over
+#define RTLOG_PER_SEC	5
+
+// one record, always the same size so the reader never waits on
+// half of one
+struct RtLogRec {
+	uint8_t code;
+	uint8_t lane;
+	uint16_t spare;
+	uint32_t size;		// bytes in the event
+};
+
+// RtLog gets messages out of the jack thread. post() only copies a
+// fixed record into a ring buffer, it never blocks, allocates or
+// prints, so it is safe to call from process(). drain() is called
+// from the gui thread and does the printing, to stderr or syslog,
+// with a limit on how much each kind of message can say.
+class RtLog
+{
+public:
+	RtLog();
+	~RtLog();
+
+	// make the ring, room for records entries. Not from process().
+	bool open (size_t records);
+	// send to syslog instead of stderr
+	void use_syslog (void);
+
+	// from process() only
+	void post (int code, int lane, uint32_t size);
+	// print what is waiting, now is any clock in microseconds
+	void drain (uint64_t now);
+
+private:
+	jack_ringbuffer_t *ring;
+	bool sys;
+	// records that did not fit, counted by process()
+	std::atomic<uint32_t> lost;
+	// rate limit, per code
+	uint64_t window[RTLOG_CODES];
+	unsigned shown[RTLOG_CODES];
+	unsigned held[RTLOG_CODES];
+
+	void say (const char* fmt, ...);
+	void tell (const RtLogRec& rec);
+};
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+// rttest runs RtCore the way rtbench does, without jack, and checks
+// what comes out of each lane for midi that has broken the lane
+// routing before. Run it with "meson test".
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "rtcore.h"
+#include "mididecode.h"
+
+// one event per period, thru and to daw copies kept for looking at
+struct TestIo {
+	const std::vector<unsigned char>* ev;
+	unsigned char out[4096];
+	size_t used;
+	std::string daw_out;
+
+	RT_INLINE uint32_t count (void) {
+		return 1;
+	}
+	RT_INLINE void get (jack_midi_event_t* e, uint32_t) {
+		e->time = 0;
+		e->size = ev->size();
+		e->buffer = (jack_midi_data_t*) &(*ev)[0];
+	}
+	RT_INLINE unsigned char* thru (size_t size) {
+		if (used + size > sizeof(out)) {
+			return 0;
+		}
+		unsigned char* b = out + used;
+		used += size;
+		return b;
+	}
+	RT_INLINE bool daw (void) {
+		return true;
+	}
+	RT_INLINE void to_daw (const unsigned char* msg, size_t len) {
+		daw_out += hex(msg, len);
+	}
+	RT_INLINE jack_time_t stamp (jack_nframes_t time) {
+		return time;
+	}
+
+	static std::string hex (const unsigned char* msg, size_t len) {
+		std::string s;
+		char b[4];
+		for (size_t i = 0; i < len; i++) {
+			snprintf(b, sizeof(b), "%02x ", msg[i]);
+			s += b;
+		}
+		s[s.size() - 1] = '|';
+		return s;
+	}
+};
+
+// messages as each lane decoder put them back together
+static std::string got[LANES];
+
+static void keep (const unsigned char* msg, size_t len, uint64_t, void* arg)
+{
+	got[(long) arg] += TestIo::hex(msg, len);
+}
+
+class Rig
+{
+public:
+	RtCore<TestIo> core;
+	TestIo io;
+	MidiDecoder* dec[LANES];
+
+	Rig(int protocol) {
+		for (long l = 0; l < LANES; l++) {
+			core.lane[l] = jack_ringbuffer_create(lane_size[l]);
+			dec[l] = new MidiDecoder(keep, (void*) l);
+			got[l].clear();
+		}
+		core.protocol = protocol;
+		core.master = true;
+	}
+	~Rig() {
+		for (int l = 0; l < LANES; l++) {
+			jack_ringbuffer_free(core.lane[l]);
+			delete dec[l];
+		}
+	}
+
+	// one event in its own period
+	void send (const std::vector<unsigned char>& ev) {
+		io.ev = &ev;
+		io.used = 0;
+		core.period(io);
+	}
+
+	// empty the lanes into the decoders, lamps first like mcpdisp
+	void drain (void) {
+		for (int l = 0; l < LANES; l++) {
+			jack_ringbuffer_t* r = core.lane[l];
+			MidiRec rec;
+			unsigned char buf[16384];
+			while (jack_ringbuffer_read_space(r) >= sizeof(MidiRec)) {
+				jack_ringbuffer_read(r, (char*) &rec, sizeof(MidiRec));
+				jack_ringbuffer_read(r, (char*) buf, rec.size);
+				dec[l]->feed(buf, rec.size, rec.stamp);
+			}
+		}
+	}
+};
+
+static int failed = 0;
+
+static void check (const char* what, const std::string& have, const char* want)
+{
+	if (have != want) {
+		printf("FAIL %s\n  want: %s\n  have: %s\n", what, want, have.c_str());
+		failed++;
+	} else {
+		printf("ok   %s\n", what);
+	}
+}
+
+// a second message in one event, then a data byte leaning on its status
+static void multi_message (void)
+{
+	Rig rig(PROTO_MCP);
+	rig.send({ 0x90, 0x5e, 0x7f, 0xd0, 0x15 });
+	rig.send({ 0x16 });
+	rig.drain();
+	check("multi message event, lamp lane", got[LANE_LAMP], "90 5e 7f|");
+	check("multi message event, level lane", got[LANE_LEVEL], "d0 15|d0 16|");
+}
+
+// HUI zone/port pairs where the port half uses running status
+static void hui_lamps (void)
+{
+	Rig rig(PROTO_HUI);
+	rig.send({ 0xb0, 0x0c, 0x0e });
+	rig.send({ 0x2c, 0x44 });
+	rig.send({ 0xb0, 0x0c, 0x00 });
+	rig.send({ 0x2c, 0x42 });
+	rig.drain();
+	check("hui running status lamps, lamp lane", got[LANE_LAMP],
+		"b0 0c 0e|b0 2c 44|b0 0c 00|b0 2c 42|");
+	check("hui running status lamps, level lane", got[LANE_LEVEL], "");
+}
+
+// the second ping comes as running status data
+static void hui_ping (void)
+{
+	Rig rig(PROTO_HUI);
+	rig.send({ 0x90, 0x00, 0x00 });
+	rig.send({ 0x00, 0x00 });
+	check("hui running status ping", rig.io.daw_out, "90 00 7f|90 00 7f|");
+}
+
+// a sysex whose middle piece finds the text lane full must not come
+// out with the pieces either side joined up
+static void sysex_gap (void)
+{
+	Rig rig(PROTO_MCP);
+	rig.send({ 0xf0, 0x00, 0x00, 0x66, 0x14, 0x12, 0x00, 'X', 'Y' });
+	rig.drain();
+	// nothing else fits for a moment
+	jack_ringbuffer_t* text = rig.core.lane[LANE_TEXT];
+	size_t fill = jack_ringbuffer_write_space(text);
+	jack_ringbuffer_write_advance(text, fill);
+	rig.send({ 'M', 'M', 'M' });
+	jack_ringbuffer_read_advance(text, fill);
+	rig.send({ 'Z', 0xf7 });
+	rig.send({ 0xf0, 0x00, 0x00, 0x66, 0x14, 0x12, 0x00, 'O', 'K', 0xf7 });
+	rig.drain();
+	check("sysex with a dropped piece", got[LANE_TEXT],
+		"f0 00 00 66 14 12 00 4f 4b f7|");
+}
+
+int main (void)
+{
+	multi_message();
+	hui_lamps();
+	hui_ping();
+	sysex_gap();
+	return failed ? 1 : 0;
+}
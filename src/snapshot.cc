@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+#define SNAP_MAGIC	"MCPDSNAP"
+#define SNAP_VERSION	2
+
+struct SnapHeader {
+	char magic[8];
+	uint32_t version;
+	// sizeof(Surface) when written, a different build will not match
+	uint32_t size;
+	uint32_t sum;
+	uint32_t pad;
+};
+
+// fnv-1a, enough to catch a file that is not ours or got damaged
+static uint32_t snap_sum (const unsigned char* data, size_t len)
+{
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		h ^= data[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+void snapshot_default (char* path, size_t len, const char* name)
+{
+	const char* cache = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	if (cache && *cache) {
+		snprintf(path, len, "%s/mcpdisp/%s.state", cache, name);
+	} else if (home && *home) {
+		snprintf(path, len, "%s/.cache/mcpdisp/%s.state", home, name);
+	} else {
+		snprintf(path, len, "/tmp/mcpdisp-%s.state", name);
+	}
+}
+
+// make the directories leading up to path, ok if they exist
+static void snap_mkdirs (const char* path)
+{
+	char dir[1024];
+	strncpy(dir, path, sizeof(dir) - 1);
+	dir[sizeof(dir) - 1] = 0x00;
+	for (char* p = dir + 1; *p; p++) {
+		if (*p == '/') {
+			*p = 0x00;
+			mkdir(dir, 0755);
+			*p = '/';
+		}
+	}
+}
+
+bool snapshot_load (const char* path, Surface* surf)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	const size_t total = sizeof(SnapHeader) + sizeof(Surface);
+	struct stat st;
+	if (fstat(fd, &st) || (size_t) st.st_size != total) {
+		close(fd);
+		return false;
+	}
+	void* map = mmap(0, total, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	const SnapHeader* head = (const SnapHeader*) map;
+	const unsigned char* body = (const unsigned char*) map + sizeof(SnapHeader);
+	bool good = !memcmp(head->magic, SNAP_MAGIC, 8)
+		&& head->version == SNAP_VERSION
+		&& head->size == sizeof(Surface)
+		&& head->sum == snap_sum(body, sizeof(Surface));
+	if (good) {
+		memcpy((void*) surf, body, sizeof(Surface));
+		surf->generation = 0;
+		surf->touch_all();
+	}
+	munmap(map, total);
+	return good;
+}
+
+bool snapshot_save (const char* path, const Surface* surf)
+{
+	char tmp[1040];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	snap_mkdirs(path);
+
+	const size_t total = sizeof(SnapHeader) + sizeof(Surface);
+	int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	if (ftruncate(fd, total)) {
+		close(fd);
+		unlink(tmp);
+		return false;
+	}
+	void* map = mmap(0, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		unlink(tmp);
+		return false;
+	}
+	SnapHeader* head = (SnapHeader*) map;
+	unsigned char* body = (unsigned char*) map + sizeof(SnapHeader);
+	memcpy(body, (const void*) surf, sizeof(Surface));
+	memcpy(head->magic, SNAP_MAGIC, 8);
+	head->version = SNAP_VERSION;
+	head->size = sizeof(Surface);
+	head->sum = snap_sum(body, sizeof(Surface));
+	head->pad = 0;
+	munmap(map, total);
+	// the swap, readers see the old file or the new one
+	if (rename(tmp, path)) {
+		unlink(tmp);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_SNAPSHOT_H
+#define MCPDISP_SNAPSHOT_H
+
+#include <stddef.h>
+
+#include "surface.h"
+
+// A snapshot is the Surface written to a small file so a restart can
+// show the last known display right away instead of waiting for the
+// daw to send it all again. It is written to a temp file through a
+// shared mapping and then renamed over the old one, so whatever is
+// on disk is always either the old or the new snapshot, never half.
+
+// fill in the usual place for client name's snapshot:
+// $XDG_CACHE_HOME/mcpdisp/<name>.state or ~/.cache/mcpdisp/<name>.state
+void snapshot_default (char* path, size_t len, const char* name);
+
+// read a snapshot into surf, false (and surf untouched) if there is
+// no usable one. Everything loaded is marked dirty.
+bool snapshot_load (const char* path, Surface* surf);
+
+// write surf out, false if that did not work
+bool snapshot_save (const char* path, const Surface* surf);
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_SURFACE_H
+#define MCPDISP_SURFACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// dirty bits, one per control or group of controls
+#define FADER_DIRTY(ch)	(1u << (ch))		// 0 - 8, 8 is master
+#define VPOT_DIRTY(ch)	(1u << (9 + (ch)))	// 0 - 7
+#define LINE1_DIRTY	(1u << 17)
+#define LINE2_DIRTY	(1u << 18)
+#define ASSIGN_DIRTY	(1u << 19)
+#define TIME_DIRTY	(1u << 20)
+#define LAMP_DIRTY	(1u << 21)		// lamp and lamp_shown differ
+#define ALL_DIRTY	((1u << 22) - 1)
+
+// Surface is everything we know about what the control surface
+// should be showing. The parser only writes here and the main loop
+// shows whatever changed once per frame, so any number of updates
+// to one control in a frame cost one redraw. It is plain data so
+// it can be saved and loaded as is.
+class Surface
+{
+public:
+	// scribble strip, 8 cells of 7 chars per line, not terminated
+	char line1[56];
+	char line2[56];
+	// two char assign display
+	char assign[2];
+	// timecode digits, 3, 6 and 9 are separators and filled in
+	// with tm_bt when shown
+	char timecode[13];
+	char tm_bt;
+	// lamp on/off by note number, one bit each, note 0 is bit 0
+	// of word 0
+	uint64_t lamp[2];
+	// fader positions 0 - 16383, 8 is the master fader
+	unsigned short fader[9];
+	// vpot ring cc value as sent: bit 6 center, 4-5 mode, 0-3 position
+	unsigned char vpot[8];
+	// last meter value as sent: 0 - 12 level, 14 overload, 15 clear
+	// overload. The strip does its own fall off so these are never
+	// shown from here and don't count as a change.
+	unsigned char meter[8];
+
+	// what has changed since the widgets were last told
+	unsigned int dirty;
+	// the lamps as the widgets last showed them, anything that
+	// differs from lamp needs showing
+	uint64_t lamp_shown[2];
+	// counts every change, lets a saver tell if there is news
+	uint32_t generation;
+
+	Surface() {
+		memset(line1, ' ', sizeof(line1));
+		memset(line2, ' ', sizeof(line2));
+		memset(assign, ' ', sizeof(assign));
+		memset(timecode, ' ', sizeof(timecode));
+		tm_bt = '|';
+		lamp[0] = lamp[1] = 0;
+		memset(fader, 0, sizeof(fader));
+		memset(vpot, 0, sizeof(vpot));
+		memset(meter, 0, sizeof(meter));
+		dirty = 0;
+		lamp_shown[0] = lamp_shown[1] = 0;
+		generation = 0;
+	}
+
+	// everything needs showing, after a restore
+	void touch_all (void) {
+		dirty = ALL_DIRTY;
+		lamp_shown[0] = ~lamp[0];
+		lamp_shown[1] = ~lamp[1];
+	}
+
+	bool lamp_on (int note) const {
+		return (lamp[note >> 6] >> (note & 63)) & 1;
+	}
+
+	void set_fader (int ch, unsigned short val) {
+		if (fader[ch] != val) {
+			fader[ch] = val;
+			dirty |= FADER_DIRTY(ch);
+			generation++;
+		}
+	}
+
+	void set_vpot (int ch, unsigned char val) {
+		if (vpot[ch] != val) {
+			vpot[ch] = val;
+			dirty |= VPOT_DIRTY(ch);
+			generation++;
+		}
+	}
+
+	void set_meter (int ch, unsigned char val) {
+		meter[ch] = val;
+	}
+
+	// pos 0 - 55 top line, 56 - 111 bottom, others ignored
+	void set_text (int pos, char c) {
+		if (pos < 56) {
+			if (line1[pos] != c) {
+				line1[pos] = c;
+				dirty |= LINE1_DIRTY;
+				generation++;
+			}
+		} else if (pos < 112) {
+			if (line2[pos - 56] != c) {
+				line2[pos - 56] = c;
+				dirty |= LINE2_DIRTY;
+				generation++;
+			}
+		}
+	}
+
+	void set_assign (int pos, char c) {
+		if (assign[pos] != c) {
+			assign[pos] = c;
+			dirty |= ASSIGN_DIRTY;
+			generation++;
+		}
+	}
+
+	void set_time (int pos, char c) {
+		if (timecode[pos] != c) {
+			timecode[pos] = c;
+			dirty |= TIME_DIRTY;
+			generation++;
+		}
+	}
+
+	void set_tm_bt (char c) {
+		if (tm_bt != c) {
+			tm_bt = c;
+			dirty |= TIME_DIRTY;
+			generation++;
+		}
+	}
+
+	void set_lamp (int note, bool on) {
+		uint64_t bit = (uint64_t) 1 << (note & 63);
+		uint64_t was = lamp[note >> 6];
+		if (on) {
+			lamp[note >> 6] |= bit;
+		} else {
+			lamp[note >> 6] &= ~bit;
+		}
+		if (lamp[note >> 6] != was) {
+			dirty |= LAMP_DIRTY;
+			generation++;
+		}
+	}
+};
+
+#endif
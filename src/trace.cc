@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#include "trace.h"
+
+#ifdef MCPDISP_TRACE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+struct TraceEvent {
+	const char* name;
+	uint64_t start;
+	uint64_t dur;
+};
+
+// one per thread, only its own thread ever writes to it
+struct TraceBuf {
+	const char* thread_name;
+	std::atomic<uint32_t> count;
+	TraceEvent ev[TRACE_EVENTS];
+};
+
+std::atomic<bool> trace_on (false);
+
+static TraceBuf bufs[TRACE_THREADS];
+static std::atomic<int> nbufs (0);
+static thread_local TraceBuf* mine = 0;
+static char trace_file[1024];
+
+uint64_t trace_now (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void trace_thread (const char* name)
+{
+	if (mine) {
+		return;
+	}
+	int n = nbufs.fetch_add(1);
+	if (n >= TRACE_THREADS) {
+		// out of buffers, this thread goes unrecorded
+		nbufs.store(TRACE_THREADS);
+		return;
+	}
+	mine = &bufs[n];
+	mine->thread_name = name;
+}
+
+void trace_span (const char* name, uint64_t start, uint64_t end)
+{
+	if (!mine) {
+		trace_thread("unnamed");
+		if (!mine) {
+			return;
+		}
+	}
+	uint32_t n = mine->count.load(std::memory_order_relaxed);
+	TraceEvent* e = &mine->ev[n % TRACE_EVENTS];
+	e->name = name;
+	e->start = start;
+	e->dur = end - start;
+	// publish after the event is filled in
+	mine->count.store(n + 1, std::memory_order_release);
+}
+
+bool trace_start (const char* file)
+{
+	strncpy(trace_file, file, sizeof(trace_file) - 1);
+	trace_on.store(true);
+	return true;
+}
+
+void trace_dump (void)
+{
+	if (!trace_on.load()) {
+		return;
+	}
+	FILE* out = fopen(trace_file, "w");
+	if (!out) {
+		perror(trace_file);
+		return;
+	}
+	fprintf(out, "{\"traceEvents\":[\n");
+	bool first = true;
+	int threads = nbufs.load();
+	if (threads > TRACE_THREADS) {
+		threads = TRACE_THREADS;
+	}
+	for (int t = 0; t < threads; t++) {
+		TraceBuf* b = &bufs[t];
+		uint32_t end = b->count.load(std::memory_order_acquire);
+		uint32_t begin = 0;
+		if (end > TRACE_EVENTS) {
+			// wrapped, leave a little slack for the oldest slots
+			// the thread may be writing over right now
+			begin = end - TRACE_EVENTS + 64;
+		}
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+			"\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", t + 1,
+			b->thread_name ? b->thread_name : "unnamed");
+		first = false;
+		for (uint32_t i = begin; i < end; i++) {
+			TraceEvent* e = &b->ev[i % TRACE_EVENTS];
+			fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+				"\"ts\":%llu,\"dur\":%llu}", e->name, t + 1,
+				(unsigned long long) e->start, (unsigned long long) e->dur);
+		}
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	fprintf(stderr, "trace written to %s\n", trace_file);
+}
+
+#endif
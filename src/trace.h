@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2015 - 2020 Len Ovens
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+
+#ifndef MCPDISP_TRACE_H
+#define MCPDISP_TRACE_H
+
+// Span tracing for finding out where a stall came from. Only built
+// when meson is configured with -Dtracing=true, otherwise every
+// TRACE_ macro is empty and none of this costs anything. Even when
+// built nothing is recorded until trace_start() is called.
+//
+// Each thread writes into its own fixed buffer so the jack thread
+// never waits on or allocates for anything. Buffers wrap, so a dump
+// holds the most recent spans of each thread.
+
+#ifdef MCPDISP_TRACE
+
+#include <stdint.h>
+#include <atomic>
+
+// spans kept per thread, and threads we have buffers for
+#define TRACE_EVENTS	65536
+#define TRACE_THREADS	4
+
+extern std::atomic<bool> trace_on;
+
+// name the calling thread in the trace, also claims its buffer
+void trace_thread (const char* name);
+// record a finished span, start and end in microseconds
+void trace_span (const char* name, uint64_t start, uint64_t end);
+uint64_t trace_now (void);
+
+// times whatever scope it lives in
+class TraceSpan
+{
+public:
+	TraceSpan(const char* n) : name(n), start(0) {
+		if (trace_on.load(std::memory_order_relaxed)) {
+			start = trace_now();
+		}
+	}
+	~TraceSpan() {
+		if (start) {
+			trace_span(name, start, trace_now());
+		}
+	}
+private:
+	const char* name;
+	uint64_t start;
+};
+
+// begin recording, dumps go to file
+bool trace_start (const char* file);
+// write what we have as chrome trace json (not from a signal handler)
+void trace_dump (void);
+
+#define TRACE_CAT2(a, b) a##b
+#define TRACE_CAT(a, b) TRACE_CAT2(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CAT(trace_span_, __LINE__)(name)
+#define TRACE_THREAD(name) trace_thread(name)
+
+#else
+
+#define TRACE_SPAN(name)
+#define TRACE_THREAD(name)
+inline bool trace_start (const char*) { return false; }
+inline void trace_dump (void) {}
+
+#endif
+
+#endif